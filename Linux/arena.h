@@ -0,0 +1,24 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+
+typedef struct Arena {
+	void *chunks;
+	char *cursor;
+	size_t remaining;
+	size_t chunk_size;
+	int node;
+} Arena;
+
+void initialize_arena(Arena *arena, size_t chunk_size);
+
+void bind_arena(Arena *arena, int node);
+
+void *alloc_arena(Arena *arena, size_t size);
+
+void release_arena(Arena *arena, void *data);
+
+void free_arena(Arena *arena);
+
+#endif
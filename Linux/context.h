@@ -0,0 +1,27 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stdlib.h>
+
+// Registers are switched by hand on x86_64, elsewhere through "ucontext"
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(SO_CONTEXT_UCONTEXT)
+#define SO_CONTEXT_ASM 1
+#else
+#define SO_CONTEXT_ASM 0
+#include <ucontext.h>
+#endif
+
+typedef struct Context {
+#if SO_CONTEXT_ASM
+	void *stack_pointer;
+#else
+	ucontext_t ucontext;
+#endif
+} Context;
+
+void initialize_context(Context *context, void *stack, size_t stack_size,
+			void (*entry)(void *), void *arg);
+
+void switch_context(Context *from, Context *to);
+
+#endif
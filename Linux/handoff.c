@@ -0,0 +1,325 @@
+#include "handoff.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SPIN_CHECK_PERIOD 32
+#define SPIN_LEARN_SHIFT 3
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() __asm__ volatile("" ::: "memory")
+#endif
+
+#if SO_USE_FUTEX
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Values of the state word, a thread is only ever parked on its own word
+#define HANDOFF_EMPTY 0	   // nobody was woken and nobody sleeps
+#define HANDOFF_TOKEN 1	   // woken, the next park returns at once
+#define HANDOFF_SLEEPING 2 // the owner sleeps in the kernel
+
+/**
+ * @brief Calls the futex system call on a state word.
+ *
+ * @param state address of the state word
+ * @param op FUTEX_WAIT_PRIVATE or FUTEX_WAKE_PRIVATE
+ * @param value expected value or number of threads to wake
+ * @return long result of the system call
+ */
+static long futex_handoff(unsigned int *state, int op, unsigned int value)
+{
+	return syscall(SYS_futex, state, op, value, NULL, NULL, 0);
+}
+
+/**
+ * @brief Initializes a handoff with no pending wake.
+ *
+ * @param handoff to be initialized
+ */
+void initialize_handoff(Handoff *handoff)
+{
+	__atomic_store_n(&handoff->state, HANDOFF_EMPTY, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Lets the owner of the handoff run, the kernel is only entered if
+ * the owner is already sleeping.
+ *
+ * @param handoff of the thread to be woken
+ */
+void wake_handoff(Handoff *handoff)
+{
+	if (__atomic_exchange_n(&handoff->state, HANDOFF_TOKEN,
+				__ATOMIC_RELEASE) != HANDOFF_SLEEPING)
+		return;
+
+	if (futex_handoff(&handoff->state, FUTEX_WAKE_PRIVATE, 1) == -1) {
+		perror("futex");
+		exit(1);
+	}
+}
+
+/**
+ * @brief Consumes a pending wake without blocking.
+ *
+ * @param handoff of the calling thread
+ * @return int "1" if a wake was consumed, "0" otherwise
+ */
+static int try_handoff(Handoff *handoff)
+{
+	unsigned int state = HANDOFF_TOKEN;
+
+	return __atomic_compare_exchange_n(&handoff->state, &state,
+					   HANDOFF_EMPTY, 0, __ATOMIC_ACQUIRE,
+					   __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Blocks the calling thread until its handoff is woken, a wake that
+ * came first is consumed without entering the kernel.
+ *
+ * @param handoff of the calling thread
+ */
+static void block_handoff(Handoff *handoff)
+{
+	unsigned int state;
+
+	for (;;) {
+		state = HANDOFF_TOKEN;
+		if (__atomic_compare_exchange_n(&handoff->state, &state,
+						HANDOFF_EMPTY, 0,
+						__ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED))
+			return;
+
+		// Announce the sleep, a wake in between is seen by the retry
+		if (state == HANDOFF_EMPTY &&
+		    !__atomic_compare_exchange_n(&handoff->state, &state,
+						 HANDOFF_SLEEPING, 0,
+						 __ATOMIC_RELAXED,
+						 __ATOMIC_RELAXED))
+			continue;
+
+		if (futex_handoff(&handoff->state, FUTEX_WAIT_PRIVATE,
+				  HANDOFF_SLEEPING) == -1 &&
+		    errno != EAGAIN && errno != EINTR) {
+			perror("futex");
+			exit(1);
+		}
+	}
+}
+
+/**
+ * @brief Gets the number of pending wakes of a handoff.
+ *
+ * @param handoff instance of the handoff
+ * @return int "1" if a wake is pending, "0" otherwise
+ */
+int get_value_handoff(Handoff *handoff)
+{
+	return __atomic_load_n(&handoff->state, __ATOMIC_RELAXED) ==
+	       HANDOFF_TOKEN;
+}
+
+/**
+ * @brief Destroys a handoff, a state word owns no resources.
+ *
+ * @param handoff to be destroyed
+ */
+void destroy_handoff(Handoff *handoff)
+{
+	(void)handoff;
+}
+
+#else
+
+/**
+ * @brief Initializes a handoff with no pending wake.
+ *
+ * @param handoff to be initialized
+ */
+void initialize_handoff(Handoff *handoff)
+{
+	if (sem_init(&handoff->semaphore, 0, 0) == -1) {
+		perror("sem_init");
+		exit(1);
+	}
+}
+
+/**
+ * @brief Lets the owner of the handoff run.
+ *
+ * @param handoff of the thread to be woken
+ */
+void wake_handoff(Handoff *handoff)
+{
+	if (sem_post(&handoff->semaphore) == -1) {
+		perror("post");
+		exit(1);
+	}
+}
+
+/**
+ * @brief Consumes a pending wake without blocking.
+ *
+ * @param handoff of the calling thread
+ * @return int "1" if a wake was consumed, "0" otherwise
+ */
+static int try_handoff(Handoff *handoff)
+{
+	return sem_trywait(&handoff->semaphore) == 0;
+}
+
+/**
+ * @brief Blocks the calling thread until its handoff is woken.
+ *
+ * @param handoff of the calling thread
+ */
+static void block_handoff(Handoff *handoff)
+{
+	while (sem_wait(&handoff->semaphore) == -1) {
+		if (errno != EINTR) {
+			perror("wait");
+			exit(1);
+		}
+	}
+}
+
+/**
+ * @brief Gets the number of pending wakes of a handoff.
+ *
+ * @param handoff instance of the handoff
+ * @return int value of the semaphore
+ */
+int get_value_handoff(Handoff *handoff)
+{
+	int value;
+
+	if (sem_getvalue(&handoff->semaphore, &value) == -1) {
+		perror("sem_getvalue");
+		exit(1);
+	}
+
+	return value;
+}
+
+/**
+ * @brief Destroys a handoff.
+ *
+ * @param handoff to be destroyed
+ */
+void destroy_handoff(Handoff *handoff)
+{
+	if (sem_destroy(&handoff->semaphore) == -1) {
+		perror("destroy");
+		exit(1);
+	}
+}
+
+#endif
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return unsigned long current time in nanoseconds
+ */
+static unsigned long now_handoff(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (unsigned long)now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+
+/**
+ * @brief Moves the spin budget towards twice the last handoff time, a
+ * handoff longer than HANDOFF_MAX_SPIN_NS pulls it towards no spinning.
+ *
+ * @param spin adaptive spin state
+ * @param elapsed_ns time the last handoff took
+ */
+static void learn_handoff(HandoffSpin *spin, unsigned long elapsed_ns)
+{
+	unsigned long budget, target = 0;
+
+	if (elapsed_ns <= HANDOFF_MAX_SPIN_NS / 2)
+		target = 2 * elapsed_ns;
+
+	budget = __atomic_load_n(&spin->budget_ns, __ATOMIC_RELAXED);
+	if (target > budget)
+		budget += (target - budget) >> SPIN_LEARN_SHIFT;
+	else
+		budget -= (budget - target) >> SPIN_LEARN_SHIFT;
+
+	// The budget would never grow back from 0 with a shift
+	if (target != 0 && budget == 0)
+		budget = 1;
+
+	__atomic_store_n(&spin->budget_ns, budget, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Blocks the calling thread until its handoff is woken. With a spin
+ * state the wake is first awaited by spinning for the learned budget, so a
+ * short handoff never puts the thread to sleep.
+ *
+ * @param handoff of the calling thread
+ * @param spin adaptive spin state, NULL to block at once
+ */
+void park_handoff(Handoff *handoff, HandoffSpin *spin)
+{
+	unsigned int i;
+	unsigned long start, budget;
+
+	if (spin == NULL) {
+		block_handoff(handoff);
+		return;
+	}
+
+	start = now_handoff();
+	budget = __atomic_load_n(&spin->budget_ns, __ATOMIC_RELAXED);
+
+	for (i = 1; budget != 0; ++i) {
+		if (try_handoff(handoff)) {
+			learn_handoff(spin, now_handoff() - start);
+			return;
+		}
+
+		cpu_relax();
+		if (i % SPIN_CHECK_PERIOD == 0 &&
+		    now_handoff() - start >= budget)
+			break;
+	}
+
+	block_handoff(handoff);
+
+	// A failed spin shrinks the budget, the time it took is inflated by
+	// the spinning itself when the CPUs are busy
+	if (budget != 0)
+		learn_handoff(spin, ~0UL);
+	else
+		learn_handoff(spin, now_handoff() - start);
+}
+
+/**
+ * @brief Wakes the next thread and parks the calling one right after, the
+ * two halves of passing the CPU from one thread to another.
+ *
+ * @param from handoff of the calling thread
+ * @param to handoff of the next thread, NULL to only park
+ * @param spin adaptive spin state, NULL to block at once
+ */
+void switch_handoff(Handoff *from, Handoff *to, HandoffSpin *spin)
+{
+	if (to != NULL)
+		wake_handoff(to);
+
+	park_handoff(from, spin);
+}
@@ -0,0 +1,40 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+// Park and wake threads on a futex state word instead of a "sem_t"
+#ifndef SO_USE_FUTEX
+#define SO_USE_FUTEX 1
+#endif
+
+#if !SO_USE_FUTEX
+#include <semaphore.h>
+#endif
+
+// Longest handoff worth spinning for, in nanoseconds
+#define HANDOFF_MAX_SPIN_NS 50000
+
+typedef struct HandoffSpin {
+	unsigned long budget_ns;
+} HandoffSpin;
+
+typedef struct Handoff {
+#if SO_USE_FUTEX
+	unsigned int state;
+#else
+	sem_t semaphore;
+#endif
+} Handoff;
+
+void initialize_handoff(Handoff *handoff);
+
+void wake_handoff(Handoff *handoff);
+
+void park_handoff(Handoff *handoff, HandoffSpin *spin);
+
+void switch_handoff(Handoff *from, Handoff *to, HandoffSpin *spin);
+
+int get_value_handoff(Handoff *handoff);
+
+void destroy_handoff(Handoff *handoff);
+
+#endif
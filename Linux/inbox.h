@@ -0,0 +1,16 @@
+#ifndef INBOX_H
+#define INBOX_H
+
+#include "linkedlist.h"
+
+typedef struct Inbox {
+	ListLink *head;
+} Inbox;
+
+void initialize_inbox(Inbox *inbox);
+
+void push_inbox(Inbox *inbox, ListLink *link);
+
+ListLink *take_inbox(Inbox *inbox);
+
+#endif
@@ -8,6 +8,14 @@ typedef struct PQData {
 	unsigned int priority;
 } PQData;
 
+typedef struct BitmapPQ {
+	LinkList *levels;
+	unsigned int num_levels;
+	unsigned int size;
+	unsigned long bitmap;
+	Arena *arena;
+} BitmapPQ;
+
 int compare_ulong_pq(void *a, void *b);
 
 void free_ulong_pq(void *data);
@@ -21,4 +29,16 @@ void pop_node_pq(LinkedList *pq);
 
 PQData *peak_pq(LinkedList *pq);
 
+BitmapPQ *initialize_bitmap_pq(unsigned int max_priority, Arena *arena);
+
+void push_link_bitmap_pq(BitmapPQ *pq, ListLink *link, unsigned int priority);
+
+ListLink *pop_link_bitmap_pq(BitmapPQ *pq);
+
+ListLink *peak_bitmap_pq(BitmapPQ *pq);
+
+int is_empty_bitmap_pq(BitmapPQ *pq);
+
+void free_bitmap_pq(BitmapPQ **pq);
+
 #endif
@@ -0,0 +1,287 @@
+/*
+ * C++20 coroutine front-end of the threads scheduler, Linux only
+ *
+ * A handler is a coroutine returning "so::task" whose scheduling points are
+ * awaited: "co_await sched.exec()", "co_await sched.wait(io)",
+ * "co_await sched.signal(io)" and "co_await sched.fork(task, priority)".
+ * Every call goes through the same priority and quantum rules as
+ * "so_exec", "so_wait", "so_signal" and "so_fork" (SO_BACKEND_EXTERNAL) and
+ * the next task is resumed straight from the awaiting one, so all the tasks
+ * run on the thread that calls "run" and a task only costs its coroutine
+ * frame, without a stack of its own.
+ *
+ * g++ 12.2 and older skip the whole body of a handler that awaits inside a
+ * condition, like "if (co_await sched.wait(io) < 0)", when the body declares
+ * no local variable (GCC bug 106188).
+ */
+
+#ifndef SO_COROUTINE_HPP_
+#define SO_COROUTINE_HPP_
+
+#include "so_scheduler_ex.h"
+
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace so {
+
+class scheduler;
+
+/*
+ * return type of a coroutine handler, it does not start before it is forked
+ */
+class task {
+public:
+	struct promise_type;
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	/* ends the task and resumes the next one */
+	struct final_awaiter {
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<>
+		await_suspend(handle_type handle) noexcept;
+		void await_resume() const noexcept {}
+	};
+
+	struct promise_type {
+		scheduler *owner = nullptr;
+
+		task get_return_object() noexcept
+		{
+			return task(handle_type::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() const noexcept
+		{
+			return {};
+		}
+		final_awaiter final_suspend() const noexcept { return {}; }
+		void return_void() const noexcept {}
+		void unhandled_exception() const noexcept { std::terminate(); }
+	};
+
+	task(task &&other) noexcept
+	    : handle_(std::exchange(other.handle_, nullptr))
+	{
+	}
+	task(const task &) = delete;
+	task &operator=(const task &) = delete;
+	task &operator=(task &&) = delete;
+	~task()
+	{
+		if (handle_)
+			handle_.destroy();
+	}
+
+private:
+	friend class scheduler;
+
+	explicit task(handle_type handle) noexcept : handle_(handle) {}
+	handle_type release() noexcept
+	{
+		return std::exchange(handle_, nullptr);
+	}
+
+	handle_type handle_;
+};
+
+/*
+ * scheduler of coroutine tasks, only one may exist at a time
+ */
+class scheduler {
+public:
+	/*
+	 * + time quantum for each task
+	 * + number of IO devices supported
+	 * throws: std::invalid_argument like "so_init" returning an error
+	 */
+	scheduler(unsigned int time_quantum, unsigned int io)
+	{
+		so_attr_t attr = {};
+
+		attr.backend = SO_BACKEND_EXTERNAL;
+		if (so_init_ex(time_quantum, io, &attr) < 0)
+			throw std::invalid_argument("so_init_ex");
+	}
+
+	/* the tasks still waiting for a signal are destroyed */
+	~scheduler()
+	{
+		so_end();
+		for (auto &entry : tasks_)
+			entry.second.destroy();
+		reap();
+	}
+
+	scheduler(const scheduler &) = delete;
+	scheduler &operator=(const scheduler &) = delete;
+
+	/*
+	 * forks the first task from outside the tasks, then runs the tasks
+	 * until each one ended or waits for a signal
+	 * returns: tid of the task or INVALID_TID
+	 */
+	tid_t run(task root, unsigned int priority)
+	{
+		tid_t tid = spawn(std::move(root), priority);
+
+		if (so_running() != INVALID_TID) {
+			tasks_.at(so_running()).resume();
+			reap();
+		}
+
+		return tid;
+	}
+
+	/* awaits: nothing, like "so_exec" */
+	auto exec() noexcept { return exec_awaiter{this}; }
+
+	/* awaits: 0 or negative on error, like "so_wait" */
+	auto wait(unsigned int io) noexcept
+	{
+		return io_awaiter{this, so_wait, io};
+	}
+
+	/* awaits: the number of woken tasks or negative, like "so_signal" */
+	auto signal(unsigned int io) noexcept
+	{
+		return io_awaiter{this, so_signal, io};
+	}
+
+	/* awaits: tid of the new task or INVALID_TID, like "so_fork" */
+	auto fork(task child, unsigned int priority) noexcept
+	{
+		return fork_awaiter{this, std::move(child), priority};
+	}
+
+private:
+	friend struct task::final_awaiter;
+
+	/*
+	 * the awaiters suspend the awaiting task around a scheduling call, then
+	 * resume the task left in the RUNNING state (the same one without any
+	 * switch)
+	 */
+	struct exec_awaiter {
+		scheduler *owner;
+
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<>
+		await_suspend(std::coroutine_handle<> handle) const noexcept
+		{
+			tid_t self = so_running();
+
+			so_exec();
+			return owner->after(self, handle);
+		}
+		void await_resume() const noexcept {}
+	};
+
+	struct io_awaiter {
+		scheduler *owner;
+		int (*call)(unsigned int io);
+		unsigned int io;
+		int result;
+
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<>
+		await_suspend(std::coroutine_handle<> handle) noexcept
+		{
+			tid_t self = so_running();
+
+			result = call(io);
+			return owner->after(self, handle);
+		}
+		int await_resume() const noexcept { return result; }
+	};
+
+	struct fork_awaiter {
+		scheduler *owner;
+		task child;
+		unsigned int priority;
+		tid_t result;
+
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<>
+		await_suspend(std::coroutine_handle<> handle) noexcept
+		{
+			tid_t self = so_running();
+
+			result = owner->spawn(std::move(child), priority);
+			return owner->after(self, handle);
+		}
+		tid_t await_resume() const noexcept { return result; }
+	};
+
+	// The handler given to "so_fork" is never called by this backend
+	static void unused_handler(unsigned int) {}
+
+	tid_t spawn(task child, unsigned int priority)
+	{
+		tid_t tid = so_fork(unused_handler, priority);
+
+		if (tid == INVALID_TID)
+			return INVALID_TID;
+
+		task::handle_type handle = child.release();
+		handle.promise().owner = this;
+		tasks_.emplace(tid, handle);
+
+		return tid;
+	}
+
+	// Task to resume once "self" made a scheduling call from "handle"
+	std::coroutine_handle<>
+	after(tid_t self, std::coroutine_handle<> handle) const noexcept
+	{
+		if (so_running() == self)
+			return handle;
+
+		return next();
+	}
+
+	// Task in the RUNNING state, the caller of "run" if none is left
+	std::coroutine_handle<> next() const noexcept
+	{
+		tid_t tid = so_running();
+
+		if (tid == INVALID_TID)
+			return std::noop_coroutine();
+
+		return tasks_.find(tid)->second;
+	}
+
+	// A finished task is suspended until the next one ends or "run" returns
+	std::coroutine_handle<> finish(task::handle_type handle) noexcept
+	{
+		tasks_.erase(so_running());
+		so_exit();
+
+		reap();
+		finished_ = handle;
+
+		return next();
+	}
+
+	void reap() noexcept
+	{
+		if (finished_)
+			finished_.destroy();
+		finished_ = nullptr;
+	}
+
+	std::unordered_map<tid_t, std::coroutine_handle<>> tasks_;
+	std::coroutine_handle<> finished_;
+};
+
+inline std::coroutine_handle<>
+task::final_awaiter::await_suspend(handle_type handle) noexcept
+{
+	return handle.promise().owner->finish(handle);
+}
+
+} // namespace so
+
+#endif
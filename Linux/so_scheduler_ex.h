@@ -0,0 +1,181 @@
+/*
+ * Threads scheduler extensions, Linux only
+ */
+
+#ifndef SO_SCHEDULER_EX_H_
+#define SO_SCHEDULER_EX_H_
+
+#include "so_scheduler.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * how the tasks are executed
+ */
+enum so_backend {
+	/*
+	 * one kernel thread per task, handed over through a futex word of
+	 * each thread (semaphores if built with SO_USE_FUTEX=0)
+	 */
+	SO_BACKEND_KERNEL = 0,
+	/*
+	 * user-space contexts with their own stacks, all run by the thread
+	 * that calls the first "so_fork"; that call returns once no task is
+	 * left to run and the tids are counters, not pthread ids
+	 */
+	SO_BACKEND_GREEN,
+	/*
+	 * the scheduler only decides which task runs: the scheduling calls
+	 * return at once and the caller runs the task given by "so_running",
+	 * ending it with "so_exit" (see so_coroutine.hpp); tids are counters
+	 */
+	SO_BACKEND_EXTERNAL
+};
+
+/*
+ * how a kernel-backend task waits for its turn
+ */
+enum so_wait_mode {
+	/* sleep in the kernel at once */
+	SO_WAIT_BLOCK = 0,
+	/*
+	 * spin for a budget learned from the recent handoff times, then
+	 * sleep; ignored on a single CPU
+	 */
+	SO_WAIT_ADAPTIVE
+};
+
+/*
+ * scheduler attributes, a zeroed struct selects the defaults
+ */
+typedef struct so_attr {
+	enum so_backend backend;
+	enum so_wait_mode wait_mode;
+	/*
+	 * kernel backend: a finished thread waits in a pool for the next
+	 * "so_fork" instead of exiting, so the tid of a finished task can be
+	 * given to a new one; "so_end" joins the pool once
+	 */
+	unsigned char thread_pool;
+	/*
+	 * stack size of every task, 0 for the default: the system's for kernel
+	 * threads and 256 KiB for green tasks, whose stacks are rounded up to
+	 * a power of two and reused from a pool of mapped stacks
+	 */
+	size_t stack_size;
+	/*
+	 * CPUs every task is pinned to, bit i selects CPU i, 0 lets them
+	 * float; with one CPU each handoff is a same-core wakeup. The green
+	 * backend pins the thread that runs the tasks until they are done
+	 */
+	unsigned long cpu_mask;
+	/*
+	 * kernel backend: number of tasks running at once, 0 or 1 for one.
+	 * Every core has its own RUNNING task and READY queue with the usual
+	 * priority and quantum rules; a forked or woken task goes to an idle
+	 * core if there is one, otherwise to the core of the forking task or
+	 * to its last core
+	 */
+	unsigned int num_cores;
+	/*
+	 * kernel backend: threads that are not tasks (IO completion threads)
+	 * may call "so_fork" and "so_signal" at any time. Such a caller is
+	 * never preempted: the tasks it forks or wakes go to an idle core or
+	 * preempt at the next scheduling point of their core ("so_exec"
+	 * included); "so_wait" fails for it. Always on with several cores
+	 */
+	unsigned char foreign_threads;
+	/*
+	 * kernel backend with several cores: memory nodes, one CPU list per
+	 * node separated by ';' ("0-3,8-11;4-7,12-15"), the i-th one for node
+	 * i, NULL to read them from sysfs. The cores are spread evenly over the
+	 * nodes and the tasks are pinned to the CPUs of their core's node, on
+	 * whose memory their attributes are allocated. A forked or woken task
+	 * goes to an idle core of its preferred core's node first and is forked
+	 * on the node of the core that takes it; an idle core only steals from
+	 * another node once its own node has no READY task. Any CPUs may be
+	 * listed, so a topology can be faked on a single-node machine; a
+	 * malformed list fails "so_init_ex"
+	 */
+	const char *numa_topology;
+} so_attr_t;
+
+/*
+ * scheduler counters
+ */
+typedef struct so_stats {
+	/* reschedules that passed the CPU to another task */
+	unsigned long switches;
+	/* reschedules that kept the running task, without any handoff */
+	unsigned long skipped_switches;
+	/* tasks taken from another core's READY queue by an idle core */
+	unsigned long steals;
+	/* steals from a core of another memory node, counted in steals too */
+	unsigned long remote_steals;
+} so_stats_t;
+
+/*
+ * creates and initializes scheduler like "so_init"
+ * + time quantum for each thread
+ * + number of IO devices supported
+ * + attributes, NULL for the defaults
+ * returns: 0 on success or negative on error
+ */
+DECL_PREFIX int so_init_ex(unsigned int time_quantum, unsigned int io,
+			   const so_attr_t *attr);
+
+/*
+ * creates a new task like "so_fork"
+ * + handler function
+ * + priority
+ * + stack size of the task, 0 for the one given to "so_init_ex"
+ * returns: tid of the new task if successful or INVALID_TID
+ */
+DECL_PREFIX tid_t so_fork_ex(so_handler *func, unsigned int priority,
+			     size_t stack_size);
+
+/*
+ * signals an io device like "so_signal" without any lock nor handoff: the
+ * request waits in an inbox until the next "so_exec", "so_wait" or task
+ * end, unless a core is idle, then the caller runs it at once; needs a
+ * scheduler shared with foreign threads or with several cores
+ * + event/io
+ * returns: 0 on success or negative on error
+ */
+DECL_PREFIX int so_signal_async(unsigned int io);
+
+/*
+ * creates a new task like "so_fork" through the inbox of "so_signal_async",
+ * its tid is not known to the caller
+ * + handler function
+ * + priority
+ * returns: 0 on success or negative on error
+ */
+DECL_PREFIX int so_fork_async(so_handler *func, unsigned int priority);
+
+/*
+ * returns: tid of the task in the RUNNING state or INVALID_TID if none
+ */
+DECL_PREFIX tid_t so_running(void);
+
+/*
+ * external backend: ends the running task, whose handler returned, and
+ * chooses the next one
+ */
+DECL_PREFIX void so_exit(void);
+
+/*
+ * copies the counters of the scheduler, they are kept after "so_end" until
+ * the next initialization
+ * + where the counters are copied
+ */
+DECL_PREFIX void so_get_stats(so_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SO_SCHEDULER_EX_H_ */
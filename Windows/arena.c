@@ -0,0 +1,123 @@
+#include "arena.h"
+#include <string.h>
+
+#define ARENA_ALIGNMENT 16
+#define ALIGN_ARENA(size) \
+	(((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define CHUNK_HEADER_SIZE ALIGN_ARENA(sizeof(void *))
+
+/**
+ * @brief Initializes an arena that hands out memory from big chunks, the
+ * memory is never given back piece by piece but all at once by "free_arena".
+ *
+ * @param arena to be initialized
+ * @param chunk_size usual size of a chunk
+ */
+void initialize_arena(Arena *arena, size_t chunk_size)
+{
+	if (arena == NULL)
+		return;
+
+	arena->chunks = NULL;
+	arena->cursor = NULL;
+	arena->remaining = 0;
+	arena->chunk_size = ALIGN_ARENA(chunk_size);
+}
+
+/**
+ * @brief Allocates a chunk and links it in the list of chunks of the arena.
+ *
+ * @param arena owner of the chunk
+ * @param size usable size of the chunk
+ * @return char* usable memory of the chunk
+ */
+static char *add_chunk_arena(Arena *arena, size_t size)
+{
+	char *chunk = malloc(CHUNK_HEADER_SIZE + size);
+
+	if (!chunk)
+		exit(12);
+
+	*(void **)chunk = arena->chunks;
+	arena->chunks = chunk;
+
+	return chunk + CHUNK_HEADER_SIZE;
+}
+
+/**
+ * @brief Allocates zeroed memory from the arena. Without an arena this is a
+ * plain "calloc", so data structures can use it whether or not they were
+ * given an arena.
+ *
+ * @param arena source of the memory, may be NULL
+ * @param size of the memory
+ * @return void* zeroed memory
+ */
+void *alloc_arena(Arena *arena, size_t size)
+{
+	char *data;
+
+	if (arena == NULL) {
+		data = calloc(1, size);
+		if (!data)
+			exit(12);
+
+		return data;
+	}
+
+	size = ALIGN_ARENA(size);
+
+	// Big requests get their own chunk so the current one is not wasted
+	if (size > arena->chunk_size / 4) {
+		data = add_chunk_arena(arena, size);
+	} else {
+		if (size > arena->remaining) {
+			arena->cursor = add_chunk_arena(arena,
+							arena->chunk_size);
+			arena->remaining = arena->chunk_size;
+		}
+
+		data = arena->cursor;
+		arena->cursor += size;
+		arena->remaining -= size;
+	}
+
+	memset(data, 0, size);
+
+	return data;
+}
+
+/**
+ * @brief Releases memory given by "alloc_arena". Memory of an arena stays
+ * until the whole arena is freed, without an arena this is a plain "free".
+ *
+ * @param arena source of the memory, may be NULL
+ * @param data to be released
+ */
+void release_arena(Arena *arena, void *data)
+{
+	if (arena == NULL)
+		free(data);
+}
+
+/**
+ * @brief Frees every chunk of the arena in one pass.
+ *
+ * @param arena to be freed
+ */
+void free_arena(Arena *arena)
+{
+	void *chunk, *next;
+
+	if (arena == NULL)
+		return;
+
+	chunk = arena->chunks;
+	while (chunk != NULL) {
+		next = *(void **)chunk;
+		free(chunk);
+		chunk = next;
+	}
+
+	initialize_arena(arena, arena->chunk_size);
+}
@@ -1,5 +1,8 @@
 #include "linkedlist.h"
 
+#define NODE_HEADER_SIZE ALIGN_POOL(sizeof(Node))
+#define POOL_LIST_CHUNK 64
+
 /**
  * @brief Compares longs.
  *
@@ -13,18 +16,28 @@ int compare_ulong(void *a, void *b)
 }
 
 /**
- * @brief Adds a node to the start of the list.
+ * @brief Creates a node that holds a copy of the data. A list created with a
+ * pool keeps the node and its data together in one slot of the pool.
  *
- * @param list source to be added
- * @param data to be added
+ * @param list owner of the node
+ * @param data to be copied
  * @param data_size of the data
+ * @return Node* new node or NULL if the data does not fit in a pool slot
  */
-void add_first_node_list(LinkedList *list, void *data, size_t data_size)
+Node *create_node_list(LinkedList *list, void *data, size_t data_size)
 {
 	Node *new_node;
 
-	if (data == NULL || list == NULL)
-		return;
+	if (list->pool != NULL) {
+		if (data_size > list->data_size)
+			return NULL;
+
+		new_node = alloc_pool(list->pool);
+		new_node->data = (char *)new_node + NODE_HEADER_SIZE;
+		memcpy(new_node->data, data, data_size);
+
+		return new_node;
+	}
 
 	new_node = malloc(sizeof(*new_node));
 
@@ -36,6 +49,47 @@ void add_first_node_list(LinkedList *list, void *data, size_t data_size)
 		exit(12);
 	memcpy(new_node->data, data, data_size);
 
+	return new_node;
+}
+
+/**
+ * @brief Frees a node of the list. For a list created with a pool "free_data"
+ * only releases what the data owns and the slot goes back to the pool.
+ *
+ * @param list owner of the node
+ * @param node to be freed
+ */
+void free_node_list(LinkedList *list, Node *node)
+{
+	if (list->pool != NULL) {
+		if (list->free_data)
+			list->free_data(node->data);
+		release_pool(list->pool, node);
+		return;
+	}
+
+	list->free_data(node->data);
+	free(node);
+}
+
+/**
+ * @brief Adds a node to the start of the list.
+ *
+ * @param list source to be added
+ * @param data to be added
+ * @param data_size of the data
+ */
+void add_first_node_list(LinkedList *list, void *data, size_t data_size)
+{
+	Node *new_node;
+
+	if (data == NULL || list == NULL)
+		return;
+
+	new_node = create_node_list(list, data, data_size);
+	if (!new_node)
+		return;
+
 	if (is_empty_list(list)) {
 		new_node->next = NULL;
 		list->head = new_node;
@@ -62,15 +116,9 @@ void add_last_node_list(LinkedList *list, void *data, size_t data_size)
 	if (data == NULL || list == NULL)
 		return;
 
-	new_node = malloc(sizeof(*new_node));
-
+	new_node = create_node_list(list, data, data_size);
 	if (!new_node)
-		exit(12);
-	new_node->data = malloc(data_size);
-
-	if (!new_node->data)
-		exit(12);
-	memcpy(new_node->data, data, data_size);
+		return;
 	new_node->next = NULL;
 
 	if (is_empty_list(list)) {
@@ -164,7 +212,8 @@ Node *get_node_list(LinkedList *list, void *data)
 }
 
 /**
- * @brief Get a node in a list and pops it from the list.
+ * @brief Get a node in a list and pops it from the list, the caller frees it
+ * with "free_node_list".
  *
  * @param list source
  * @param data to be searched for
@@ -235,8 +284,7 @@ void remove_node_list(LinkedList *list, void *data)
 
 	if (get_size_list(list) == 1 &&
 	    !list->compare_function(list->head->data, data)) {
-		list->free_data(list->head->data);
-		free(list->head);
+		free_node_list(list, list->head);
 		list->head = NULL;
 		list->tail = NULL;
 		list->size--;
@@ -248,8 +296,7 @@ void remove_node_list(LinkedList *list, void *data)
 
 		list->head = list->head->next;
 		list->size--;
-		list->free_data(tmp->data);
-		free(tmp);
+		free_node_list(list, tmp);
 		return;
 	}
 
@@ -259,8 +306,7 @@ void remove_node_list(LinkedList *list, void *data)
 		if (!list->compare_function(curr->data, data)) {
 			prev->next = curr->next;
 			list->size--;
-			list->free_data(curr->data);
-			free(curr);
+			free_node_list(list, curr);
 			return;
 		}
 		prev = curr;
@@ -273,8 +319,7 @@ void remove_node_list(LinkedList *list, void *data)
 		prev->next = NULL;
 		list->tail = prev;
 		list->size--;
-		list->free_data(tmp->data);
-		free(tmp);
+		free_node_list(list, tmp);
 	}
 }
 
@@ -323,15 +368,19 @@ void free_list(LinkedList **list)
 
 	curr = (*list)->head;
 
+	// Pooled nodes with nothing to release go away together with the pool
+	if ((*list)->pool != NULL && (*list)->free_data == NULL)
+		curr = NULL;
+
 	while (curr != NULL) {
 		Node *tmp = curr;
 
 		curr = curr->next;
-		(*list)->free_data(tmp->data);
-		free(tmp);
+		free_node_list(*list, tmp);
 	}
 
-	free(*list);
+	free_pool(&(*list)->pool);
+	release_arena((*list)->arena, *list);
 }
 
 /**
@@ -357,3 +406,110 @@ LinkedList *initialize_list(int (*compare_function)(void *, void *),
 
 	return list;
 }
+
+/**
+ * @brief Initializes an intrusive list, the links are embedded in the
+ * elements themselves so adding and removing never allocates memory.
+ *
+ * @param list to be initialized
+ */
+void initialize_link_list(LinkList *list)
+{
+	if (list == NULL)
+		return;
+
+	list->head = NULL;
+	list->tail = NULL;
+	list->size = 0;
+}
+
+/**
+ * @brief Adds a link to the end of an intrusive list.
+ *
+ * @param list source to be added
+ * @param link embedded in the element to be added
+ */
+void add_last_link_list(LinkList *list, ListLink *link)
+{
+	if (list == NULL || link == NULL)
+		return;
+
+	link->next = NULL;
+
+	if (list->tail == NULL)
+		list->head = link;
+	else
+		list->tail->next = link;
+
+	list->tail = link;
+	list->size++;
+}
+
+/**
+ * @brief Removes the first link of an intrusive list.
+ *
+ * @param list source
+ * @return ListLink* removed link or NULL if the list is empty
+ */
+ListLink *pop_first_link_list(LinkList *list)
+{
+	ListLink *link;
+
+	if (list == NULL || list->head == NULL)
+		return NULL;
+
+	link = list->head;
+	list->head = link->next;
+	list->size--;
+
+	if (list->head == NULL)
+		list->tail = NULL;
+
+	link->next = NULL;
+
+	return link;
+}
+
+/**
+ * @brief Checks if an intrusive list is empty.
+ *
+ * @param list source
+ * @return int "1" for true, "0" for false, "-1" on error
+ */
+int is_empty_link_list(LinkList *list)
+{
+	if (list == NULL)
+		return -1;
+
+	return list->head == NULL;
+}
+
+/**
+ * @brief Initializes a list whose nodes come from a pool sized for the data,
+ * a node and its data share one slot that is reused once the node is freed.
+ *
+ * @param compare_function to be used for searching a node
+ * @param print_function to be used for printing a node
+ * @param free_data to be used for releasing what a node's data owns, may be
+ * NULL since the data itself is stored in the slot
+ * @param data_size biggest data stored in the list
+ * @param arena that owns the list and its pool, NULL to use the heap
+ * @return LinkedList* new list instance
+ */
+LinkedList *initialize_pool_list(int (*compare_function)(void *, void *),
+				 void (*print_function)(void *),
+				 void (*free_data)(void *), size_t data_size,
+				 Arena *arena)
+{
+	LinkedList *list = alloc_arena(arena, sizeof(*list));
+
+	list->compare_function = compare_function;
+	list->print_function = print_function;
+	list->free_data = free_data;
+	list->data_size = data_size;
+	list->arena = arena;
+	list->pool = initialize_pool(NODE_HEADER_SIZE + data_size,
+				     POOL_LIST_CHUNK, arena);
+
+	return list;
+}
@@ -1,10 +1,16 @@
 #ifndef LINKEDLIST_H
 #define LINKEDLIST_H
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "pool.h"
+
+#define container_of_link(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
 typedef struct Node {
 	void *data;
 	struct Node *next;
@@ -17,8 +23,21 @@ typedef struct LinkedList {
 	int (*compare_function)(void *a, void *b);
 	void (*print_function)(void *a);
 	void (*free_data)();
+	MemoryPool *pool;
+	size_t data_size;
+	Arena *arena;
 } LinkedList;
 
+typedef struct ListLink {
+	struct ListLink *next;
+} ListLink;
+
+typedef struct LinkList {
+	struct ListLink *head;
+	struct ListLink *tail;
+	unsigned int size;
+} LinkList;
+
 int compare_ulong(void *a, void *b);
 
 int has_node_list(LinkedList *list, void *data);
@@ -29,6 +48,10 @@ void print_ulong(void *data);
 
 void print_list(LinkedList *list);
 
+Node *create_node_list(LinkedList *list, void *data, size_t data_size);
+
+void free_node_list(LinkedList *list, Node *node);
+
 void add_first_node_list(LinkedList *list, void *data, size_t data_size);
 
 void add_last_node_list(LinkedList *list, void *data, size_t data_size);
@@ -45,8 +68,21 @@ Node *pop_node_list(LinkedList *list, void *data);
 
 void free_list(LinkedList **list);
 
+void initialize_link_list(LinkList *list);
+
+void add_last_link_list(LinkList *list, ListLink *link);
+
+ListLink *pop_first_link_list(LinkList *list);
+
+int is_empty_link_list(LinkList *list);
+
 LinkedList *initialize_list(int (*compare_function)(void *, void *),
 			    void (*print_function)(void *),
 			    void (*free_data)(void *));
 
+LinkedList *initialize_pool_list(int (*compare_function)(void *, void *),
+				 void (*print_function)(void *),
+				 void (*free_data)(void *), size_t data_size,
+				 Arena *arena);
+
 #endif
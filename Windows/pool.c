@@ -0,0 +1,119 @@
+#include "pool.h"
+
+/**
+ * @brief Initializes a pool of fixed-size slots. Slots are carved from chunks
+ * that are never returned to the system before the pool is freed, a released
+ * slot is pushed on a free list and handed out again by the next allocation.
+ *
+ * @param slot_size size of every slot
+ * @param slots_per_chunk number of slots allocated at once
+ * @param arena that owns the pool and its chunks, NULL to use the heap
+ * @return MemoryPool* new pool instance
+ */
+MemoryPool *initialize_pool(size_t slot_size, unsigned int slots_per_chunk,
+			    Arena *arena)
+{
+	MemoryPool *pool = alloc_arena(arena, sizeof(*pool));
+
+	// A free slot stores the address of the next free slot
+	if (slot_size < sizeof(void *))
+		slot_size = sizeof(void *);
+
+	pool->slot_size = ALIGN_POOL(slot_size);
+	pool->slots_per_chunk = slots_per_chunk ? slots_per_chunk : 1;
+	pool->arena = arena;
+
+	return pool;
+}
+
+/**
+ * @brief Allocates a new chunk and threads all of its slots on the free list.
+ *
+ * @param pool instance of the pool
+ */
+static void grow_pool(MemoryPool *pool)
+{
+	unsigned int i;
+	char *chunk, *slot;
+
+	// The first aligned block of a chunk links it to the previous chunk
+	chunk = alloc_arena(pool->arena,
+			    ALIGN_POOL(sizeof(void *)) +
+				pool->slot_size * pool->slots_per_chunk);
+
+	*(void **)chunk = pool->chunks;
+	pool->chunks = chunk;
+
+	slot = chunk + ALIGN_POOL(sizeof(void *));
+	for (i = 0; i < pool->slots_per_chunk; ++i) {
+		*(void **)slot = pool->free_slots;
+		pool->free_slots = slot;
+		slot += pool->slot_size;
+	}
+}
+
+/**
+ * @brief Takes a slot from the pool.
+ *
+ * @param pool instance of the pool
+ * @return void* slot of "slot_size" bytes
+ */
+void *alloc_pool(MemoryPool *pool)
+{
+	void *slot;
+
+	if (pool == NULL)
+		return NULL;
+
+	if (pool->free_slots == NULL)
+		grow_pool(pool);
+
+	slot = pool->free_slots;
+	pool->free_slots = *(void **)slot;
+
+	return slot;
+}
+
+/**
+ * @brief Gives a slot back to the pool so it can be reused.
+ *
+ * @param pool instance of the pool
+ * @param slot previously returned by "alloc_pool"
+ */
+void release_pool(MemoryPool *pool, void *slot)
+{
+	if (pool == NULL || slot == NULL)
+		return;
+
+	*(void **)slot = pool->free_slots;
+	pool->free_slots = slot;
+}
+
+/**
+ * @brief Frees every chunk of the pool and the pool itself, a pool owned by
+ * an arena is freed together with the arena.
+ *
+ * @param pool instance of the pool
+ */
+void free_pool(MemoryPool **pool)
+{
+	void *chunk, *next;
+
+	if (pool == NULL || *pool == NULL)
+		return;
+
+	if ((*pool)->arena != NULL) {
+		*pool = NULL;
+		return;
+	}
+
+	chunk = (*pool)->chunks;
+	while (chunk != NULL) {
+		next = *(void **)chunk;
+		free(chunk);
+		chunk = next;
+	}
+
+	free(*pool);
+	*pool = NULL;
+}
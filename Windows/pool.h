@@ -0,0 +1,28 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "arena.h"
+#include <stdlib.h>
+
+#define POOL_ALIGNMENT 16
+#define ALIGN_POOL(size) \
+	(((size) + POOL_ALIGNMENT - 1) & ~(size_t)(POOL_ALIGNMENT - 1))
+
+typedef struct MemoryPool {
+	void *free_slots;
+	void *chunks;
+	size_t slot_size;
+	unsigned int slots_per_chunk;
+	Arena *arena;
+} MemoryPool;
+
+MemoryPool *initialize_pool(size_t slot_size, unsigned int slots_per_chunk,
+			    Arena *arena);
+
+void *alloc_pool(MemoryPool *pool);
+
+void release_pool(MemoryPool *pool, void *slot);
+
+void free_pool(MemoryPool **pool);
+
+#endif
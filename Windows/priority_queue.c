@@ -65,15 +65,11 @@ void push_node_pq(LinkedList *pq, void *data, size_t data_size,
 	} else if (((PQData *)pq->tail->data)->priority >= priority) {
 		add_last_node_list(pq, &pqdata, sizeof(PQData));
 	} else {
-		new_node = malloc(sizeof(*new_node));
-
-		if (!new_node)
-			exit(12);
-		new_node->data = malloc(sizeof(PQData));
-
-		if (!new_node->data)
-			exit(12);
-		memcpy(new_node->data, &pqdata, sizeof(PQData));
+		new_node = create_node_list(pq, &pqdata, sizeof(PQData));
+		if (!new_node) {
+			free(pqdata.data);
+			return;
+		}
 
 		prev = pq->head;
 		curr = prev->next;
@@ -109,8 +105,7 @@ void pop_node_pq(LinkedList *pq)
 	head = pq->head;
 	next = head->next;
 
-	pq->free_data(head->data);
-	free(pq->head);
+	free_node_list(pq, head);
 	pq->head = next;
 	pq->size--;
 
@@ -131,3 +126,133 @@ PQData *peak_pq(LinkedList *pq)
 
 	return (PQData *)pq->head->data;
 }
+
+/**
+ * @brief Returns the index of the most significant bit set in a bitmap.
+ *
+ * @param bitmap non-zero bitmap
+ * @return unsigned int index of the highest bit set
+ */
+static unsigned int highest_bit_pq(unsigned long bitmap)
+{
+#if defined(__GNUC__)
+	return sizeof(unsigned long) * 8 - 1 - __builtin_clzl(bitmap);
+#else
+	unsigned int index = 0;
+
+	while (bitmap >>= 1)
+		index++;
+
+	return index;
+#endif
+}
+
+/**
+ * @brief Initializes a Priority Queue that holds one FIFO list for every
+ * priority level and a bitmap of the non-empty levels, thus push, pop and
+ * peak are done in constant time. The queue is intrusive, the caller embeds a
+ * "ListLink" in every element so no memory is allocated after this call.
+ *
+ * @param max_priority biggest priority that will be pushed
+ * @param arena that owns the Priority Queue, NULL to use the heap
+ * @return BitmapPQ* new Priority Queue instance or NULL on error
+ */
+BitmapPQ *initialize_bitmap_pq(unsigned int max_priority, Arena *arena)
+{
+	BitmapPQ *pq;
+
+	if (max_priority >= sizeof(unsigned long) * 8)
+		return NULL;
+
+	pq = alloc_arena(arena, sizeof(*pq));
+	pq->num_levels = max_priority + 1;
+	pq->levels = alloc_arena(arena, pq->num_levels * sizeof(LinkList));
+	pq->arena = arena;
+
+	return pq;
+}
+
+/**
+ * @brief Adds a link at the end of its priority level, links with the same
+ * priority are served in the order they were pushed.
+ *
+ * @param pq instance of Priority Queue
+ * @param link embedded in the element to be stored
+ * @param priority associated priority of the element
+ */
+void push_link_bitmap_pq(BitmapPQ *pq, ListLink *link, unsigned int priority)
+{
+	if (pq == NULL || link == NULL || priority >= pq->num_levels)
+		return;
+
+	add_last_link_list(&pq->levels[priority], link);
+	pq->bitmap |= 1UL << priority;
+	pq->size++;
+}
+
+/**
+ * @brief Removes the top link from the Priority Queue.
+ *
+ * @param pq instance of Priority Queue
+ * @return ListLink* removed link or NULL if the queue is empty
+ */
+ListLink *pop_link_bitmap_pq(BitmapPQ *pq)
+{
+	unsigned int priority;
+	ListLink *link;
+
+	if (pq == NULL || pq->bitmap == 0)
+		return NULL;
+
+	priority = highest_bit_pq(pq->bitmap);
+	link = pop_first_link_list(&pq->levels[priority]);
+	pq->size--;
+
+	if (is_empty_link_list(&pq->levels[priority]))
+		pq->bitmap &= ~(1UL << priority);
+
+	return link;
+}
+
+/**
+ * @brief Returns top link of the Priority Queue.
+ *
+ * @param pq instance of Priority Queue
+ * @return ListLink* top link or NULL if the queue is empty
+ */
+ListLink *peak_bitmap_pq(BitmapPQ *pq)
+{
+	if (pq == NULL || pq->bitmap == 0)
+		return NULL;
+
+	return pq->levels[highest_bit_pq(pq->bitmap)].head;
+}
+
+/**
+ * @brief Checks if the Priority Queue is empty.
+ *
+ * @param pq instance of Priority Queue
+ * @return int "1" for true, "0" for false, "-1" on error
+ */
+int is_empty_bitmap_pq(BitmapPQ *pq)
+{
+	if (pq == NULL)
+		return -1;
+
+	return pq->bitmap == 0;
+}
+
+/**
+ * @brief Frees the Priority Queue, the linked elements belong to the caller.
+ *
+ * @param pq instance of Priority Queue
+ */
+void free_bitmap_pq(BitmapPQ **pq)
+{
+	if (pq == NULL || *pq == NULL)
+		return;
+
+	release_arena((*pq)->arena, (*pq)->levels);
+	release_arena((*pq)->arena, *pq);
+	*pq = NULL;
+}
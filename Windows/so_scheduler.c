@@ -1,20 +1,21 @@
 #include "so_scheduler.h"
-#include "hashtable.h"
 #include "priority_queue.h"
+#include "task_table.h"
 #include <string.h>
 
-#define HT_CAPACITY 100
+#define HT_CAPACITY 64
+#define ARENA_CHUNK_SIZE (64 * 1024)
 
-typedef struct so_scheduler_t {
-	HashTable *pthreads_data;	// id to pthread information
-	PQData running_thread;		// current running thread
-	LinkedList *ready_threads_pq;	// ready threads priority queue
-	LinkedList *waiting_threads;	// waiting threads list
-	LinkedList *pthreads_created;	// list of all threads created
-	unsigned int time_quantum;	// time quantum for a thread
-	unsigned int io;		// maximum io time
-	unsigned char isAThreadRunning; // flag for first ever fork
-} so_scheduler_t;
+// Take every internal allocation from an arena released at once by "so_end"
+#ifndef SO_USE_ARENA
+#define SO_USE_ARENA 1
+#endif
+
+#if SO_USE_ARENA
+#define SCHEDULER_ARENA (&so_scheduler.arena)
+#else
+#define SCHEDULER_ARENA NULL
+#endif
 
 typedef struct pthread_param_t {
 	HANDLE semaphore;	   // thread semaphore
@@ -22,148 +23,139 @@ typedef struct pthread_param_t {
 	so_handler *func;	   // thread function
 	unsigned int priority;	   // thread priority
 	unsigned int time_quantum; // thread time since running
-	HANDLE hThread;		   // thread handle
+	unsigned int io;	   // thread io waiting signal
+	unsigned int index;	   // index in the task table
+	ListLink link;		   // "ready" or "waiting" queue linkage
 } pthread_param_t;
 
-typedef struct waiting_pthread_t {
-	DWORD pthread_id;      // thread id
-	unsigned int priority; // thread priority
-	unsigned int io;       // thread io waiting signal
-} waiting_pthread_t;
+typedef struct so_scheduler_t {
+	pthread_param_t *running_thread;	// current running thread
+	TaskTable tasks;		// attributes of every live thread
+	BitmapPQ *ready_threads_pq;	// ready threads priority queue
+	LinkList waiting_threads[SO_MAX_NUM_EVENTS]; // waiting threads per io
+	unsigned int num_waiting;	// number of waiting threads
+	LONG num_live;			// threads not finished yet
+	HANDLE end_event;		// set by the last thread to finish
+	CRITICAL_SECTION end_lock;	// orders the last set before "so_end"
+	unsigned int time_quantum;	// time quantum for a thread
+	unsigned int io;		// maximum io time
+	unsigned char isAThreadRunning; // flag for first ever fork
+	Arena arena;			// memory used until "so_end"
+} so_scheduler_t;
 
 so_scheduler_t so_scheduler = {0};
 
+// Attributes of the scheduled thread that executes the code
+static __declspec(thread) pthread_param_t *current_pthread_param;
+
 /**
- * @brief Used in HashTable to compare keys based on pthread.
+ * @brief Used by LinkedList to prints "pthread_param_t" struct.
  *
- * @param a HashTable current key represented as an "Entry" struct
- * @param b key to be searched
- * @return int "0" on success
+ * @param data current node data
  */
-int compare_pthreads_attr(void *a, void *b)
+void print_pthreads_attr(void *data)
 {
-	return !(*((DWORD *)((Entry *)a)->key) == *(DWORD *)b);
+	printf("pthread_id: %ld, function address: %p, "
+	       "priority: %u; ",
+	       ((pthread_param_t *)data)->pthread_id,
+	       ((pthread_param_t *)data)->func,
+	       ((pthread_param_t *)data)->priority);
 }
 
 /**
- * @brief Used in LinkedList to compare node data based on thread id.
+ * @brief Marks the most important thread as active.
  *
- * @param a List current node represented as a "waiting_pthread_t" struct
- * @param b thread node to be searched
- * @return int "0" on success
+ * @param pthread_param "pthread_param_t" structure of the most important
+ * thread
  */
-int compare_io_signal_thread(void *a, void *b)
+void set_fastest_thread(pthread_param_t *pthread_param)
 {
-	return !(((waiting_pthread_t *)a)->io == *(unsigned int *)b);
+	so_scheduler.running_thread = pthread_param;
 }
 
 /**
- * @brief Used by LinkedList to prints "waiting_pthread_t" struct.
+ * @brief Gets the attributes of the calling thread without any lookup, a
+ * thread that is not scheduled gets the "running" thread as before.
  *
- * @param data current node data
+ * @return pthread_param_t* attributes of the calling thread
  */
-void print_waiting_pthread(void *data)
+static pthread_param_t *get_current_thread(void)
 {
-	printf("pthread id: %lu, io: %u, priority: %u; ",
-	       ((waiting_pthread_t *)data)->pthread_id,
-	       ((waiting_pthread_t *)data)->io,
-	       ((waiting_pthread_t *)data)->priority);
+	if (current_pthread_param != NULL)
+		return current_pthread_param;
+
+	return so_scheduler.running_thread;
 }
 
 /**
- * @brief Used by LinkedList to prints "pthread_param_t" struct.
+ * @brief Removes the most important thread from the "ready" state.
  *
- * @param data current node data
+ * @return pthread_param_t* removed thread or NULL if no thread is "ready"
  */
-void print_pthreads_attr(void *data)
+pthread_param_t *pop_fastest_thread(void)
 {
-	printf("pthread_id: %ld, function address: %p, "
-	       "priority: %u; ",
-	       ((pthread_param_t *)data)->pthread_id,
-	       ((pthread_param_t *)data)->func,
-	       ((pthread_param_t *)data)->priority);
+	ListLink *link = pop_link_bitmap_pq(so_scheduler.ready_threads_pq);
+
+	if (link == NULL)
+		return NULL;
+
+	return container_of_link(link, pthread_param_t, link);
 }
 
 /**
- * @brief Used by HashTable to free all entries where the key is a thread id
- * and the value a "pthread_param_t" struct.
+ * @brief Passes the CPU from the running thread to the thread chosen to run
+ * next. When the running thread was chosen again it simply keeps running, no
+ * semaphore is released nor waited on.
  *
- * @param data current entry
+ * @param prev "pthread_param_t" structure of the running thread
+ * @param next "pthread_param_t" structure of the next thread
  */
-void free_entries_pthreads_attr(void *data)
+static void switch_thread(pthread_param_t *prev, pthread_param_t *next)
 {
-	Entry *entry;
+	int ret;
 
-	if (data == NULL)
+	if (prev == next)
 		return;
 
-	entry = (Entry *)data;
-
-	if (!CloseHandle(((pthread_param_t *)entry->value)->semaphore)) {
-		perror("close");
+	// Start execution for the new thread
+	if (!ReleaseSemaphore(next->semaphore, 1, NULL)) {
+		perror("release");
 		exit(1);
-	};
-
-	free(entry->key);
-	free(entry->value);
-	free(entry);
-}
-
-/**
- * @brief Marks the most important thread as active.
- *
- * @param max_priority_thread "PQData" structure of the most important thread
- */
-void set_fastest_thread(PQData *max_priority_thread)
-{
-	memcpy(so_scheduler.running_thread.data, max_priority_thread->data,
-	       sizeof(DWORD));
-	so_scheduler.running_thread.priority = max_priority_thread->priority;
+	}
+	// Stop execution for the old thread
+	ret = WaitForSingleObject(prev->semaphore, INFINITE);
+	if (ret == WAIT_FAILED) {
+		perror("acquire");
+		exit(1);
+	}
 }
 
 /**
  * @brief Set the running thread after the current thread's quantum expired.
  *
- * @param running_pthread_pararm "PQData" structure of the running thread
+ * @param running_pthread_pararm "pthread_param_t" structure of the running
+ * thread
  */
 void set_fastest_thread_after_quantum(pthread_param_t *running_pthread_pararm)
 {
-	PQData *max_priority_thread;
 	pthread_param_t *ready_pthread_pararm;
-	int ret;
 
 	// Reset internal timer for the running thread
 	running_pthread_pararm->time_quantum = so_scheduler.time_quantum;
 
 	// Add running thread to the poll of "ready" threads
-	push_node_pq(so_scheduler.ready_threads_pq,
-		     &running_pthread_pararm->pthread_id, sizeof(DWORD),
-		     running_pthread_pararm->priority);
+	push_link_bitmap_pq(so_scheduler.ready_threads_pq,
+			    &running_pthread_pararm->link,
+			    running_pthread_pararm->priority);
 
-	// Get max priority "ready" thread
-	max_priority_thread = peak_pq(so_scheduler.ready_threads_pq);
-
-	// Get max priority "ready" thread parameters
-	ready_pthread_pararm = (pthread_param_t *)get_value_hashtable(
-	    max_priority_thread->data, so_scheduler.pthreads_data);
+	// Remove max priority thread from "ready" state
+	ready_pthread_pararm = pop_fastest_thread();
 
 	// Mark most important thread as running
-	set_fastest_thread(max_priority_thread);
-
-	// Remove the thread from "ready" state
-	pop_node_pq(so_scheduler.ready_threads_pq);
+	set_fastest_thread(ready_pthread_pararm);
 
-	// Start execution for the new thread
-	if (!ReleaseSemaphore(ready_pthread_pararm->semaphore, 1, NULL)) {
-		perror("release");
-		exit(1);
-	}
-	// Stop execution for the old thread
-	ret = WaitForSingleObject(running_pthread_pararm->semaphore, INFINITE);
-	if (ret == WAIT_FAILED) {
-		perror("acquire 2");
-		exit(1);
-	}
+	// Start the new thread and stop the old one
+	switch_thread(running_pthread_pararm, ready_pthread_pararm);
 }
 
 /**
@@ -176,27 +168,31 @@ void set_fastest_thread_after_quantum(pthread_param_t *running_pthread_pararm)
  */
 int so_init(unsigned int time_quantum, unsigned int io)
 {
+	unsigned int i;
+
 	if (io > SO_MAX_NUM_EVENTS || time_quantum == 0 ||
 	    so_scheduler.time_quantum != 0)
 		return -1;
 
 	// Pass internal parameters
+	so_scheduler.end_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (so_scheduler.end_event == NULL) {
+		perror("CreateEvent");
+		exit(1);
+	}
+	InitializeCriticalSection(&so_scheduler.end_lock);
 	so_scheduler.time_quantum = time_quantum;
 	so_scheduler.io = io;
 
 	// Initialize internal data structures
-	so_scheduler.pthreads_data = initialize_hashtable(
-	    HT_CAPACITY, hash_function_ulong, compare_pthreads_attr,
-	    print_pthreads_attr, free_entries_pthreads_attr, 0);
+	initialize_arena(&so_scheduler.arena, ARENA_CHUNK_SIZE);
+	initialize_task_table(&so_scheduler.tasks, sizeof(pthread_param_t),
+			      HT_CAPACITY, SCHEDULER_ARENA);
 	so_scheduler.ready_threads_pq =
-	    initialize_list(compare_ulong_pq, print_ulong_pq, free_ulong_pq);
-	so_scheduler.pthreads_created =
-	    initialize_list(compare_ulong, print_ulong, free);
-	so_scheduler.waiting_threads = initialize_list(
-	    compare_io_signal_thread, print_waiting_pthread, free);
+	    initialize_bitmap_pq(SO_MAX_PRIO, SCHEDULER_ARENA);
+	for (i = 0; i < io; ++i)
+		initialize_link_list(&so_scheduler.waiting_threads[i]);
 
-	// Dynamic allocation for a deep copy of a thread id
-	so_scheduler.running_thread.data = malloc(sizeof(DWORD));
 
 	return 0;
 }
@@ -213,6 +209,10 @@ DWORD WINAPI start_thread(LPVOID data)
 {
 	int ret;
 	pthread_param_t *pthread_param = (pthread_param_t *)data;
+	pthread_param_t *ready_pthread_pararm;
+
+	// Remember own attributes for the scheduler calls made by the handler
+	current_pthread_param = pthread_param;
 
 	// Waits until another thread signals that its his turn
 	ret = WaitForSingleObject(pthread_param->semaphore, INFINITE);
@@ -225,26 +225,35 @@ DWORD WINAPI start_thread(LPVOID data)
 	pthread_param->func(pthread_param->priority);
 
 	// Gives "running" state to next thread based on priority
-	if (!is_empty_list(so_scheduler.ready_threads_pq)) {
-		PQData *max_priority_thread =
-		    peak_pq(so_scheduler.ready_threads_pq);
-		pthread_param_t *ready_pthread_pararm =
-		    (pthread_param_t *)get_value_hashtable(
-			max_priority_thread->data, so_scheduler.pthreads_data);
+	ready_pthread_pararm = pop_fastest_thread();
+	if (ready_pthread_pararm != NULL)
+		set_fastest_thread(ready_pthread_pararm);
 
-		// Sets currently running thread
-		set_fastest_thread(max_priority_thread);
+	// No thread will signal a finished thread again, its index and
+	// attributes are recycled while it still holds the "running" state
+	if (!CloseHandle(pthread_param->semaphore)) {
+		perror("close");
+		exit(1);
+	}
+	release_task_table(&so_scheduler.tasks, pthread_param->index);
 
-		// Removes thread from "ready" state
-		pop_node_pq(so_scheduler.ready_threads_pq);
+	// Set running thread as active
+	if (ready_pthread_pararm != NULL &&
+	    !ReleaseSemaphore(ready_pthread_pararm->semaphore, 1, NULL)) {
+		perror("release");
+		exit(1);
+	}
 
-		// Set running thread as active
-		if (!ReleaseSemaphore(ready_pthread_pararm->semaphore, 1,
-				      NULL)) {
-			perror("release");
-			exit(1);
-		}
+	// The last thread to finish wakes "so_end", nothing of the scheduler is
+	// touched after it is counted out. The end lock keeps "so_end" from
+	// closing the event between the count and the set
+	EnterCriticalSection(&so_scheduler.end_lock);
+	if (InterlockedDecrement(&so_scheduler.num_live) == 0 &&
+	    !SetEvent(so_scheduler.end_event)) {
+		perror("SetEvent");
+		exit(1);
 	}
+	LeaveCriticalSection(&so_scheduler.end_lock);
 
 	return 0;
 }
@@ -259,13 +268,18 @@ DWORD WINAPI start_thread(LPVOID data)
 DWORD so_fork(so_handler *func, unsigned int priority)
 {
 	int ret;
+	HANDLE hThread;
 	pthread_param_t *pthread_param;
+	unsigned int index;
+	DWORD tid;
 
 	if (priority > SO_MAX_PRIO || func == NULL)
 		return INVALID_TID;
 
-	// Set thread parameters
-	pthread_param = malloc(sizeof(pthread_param_t));
+	// Set thread parameters in a free entry of the task table
+	index = alloc_task_table(&so_scheduler.tasks);
+	pthread_param = get_task_table(&so_scheduler.tasks, index);
+	pthread_param->index = index;
 	pthread_param->func = func;
 	pthread_param->priority = priority;
 	pthread_param->time_quantum = so_scheduler.time_quantum;
@@ -277,35 +291,25 @@ DWORD so_fork(so_handler *func, unsigned int priority)
 		exit(1);
 	}
 
-	// Create thread
-	pthread_param->hThread =
-	    CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)start_thread,
-			 pthread_param, 0, &pthread_param->pthread_id);
-	if (pthread_param->hThread == NULL) {
+	// Create thread, it is counted out by itself instead of being waited
+	InterlockedIncrement(&so_scheduler.num_live);
+	hThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)start_thread,
+			       pthread_param, 0, &pthread_param->pthread_id);
+	if (hThread == NULL || !CloseHandle(hThread)) {
 		perror("CreateThread");
 		exit(1);
 	}
+	tid = pthread_param->pthread_id;
 
-	// Add thread to list of all threads ever created
-	add_last_node_list(so_scheduler.pthreads_created,
-			   &pthread_param->hThread, sizeof(HANDLE));
 	// Add thread to "ready" state priority queue
-	push_node_pq(so_scheduler.ready_threads_pq, &pthread_param->pthread_id,
-		     sizeof(pthread_param->pthread_id),
-		     pthread_param->priority);
-	// Map thread id to its properties
-	put_hashtable(&pthread_param->pthread_id,
-		      sizeof(pthread_param->pthread_id), pthread_param,
-		      sizeof(pthread_param), so_scheduler.pthreads_data);
+	push_link_bitmap_pq(so_scheduler.ready_threads_pq, &pthread_param->link,
+			    pthread_param->priority);
 
 	// Sets to "running" the most important thread
 	if (so_scheduler.isAThreadRunning) {
 		// Not first ever fork -> normal procedure (get running thread
-		// data)
-		pthread_param_t *running_pthread_pararm =
-		    (pthread_param_t *)get_value_hashtable(
-			so_scheduler.running_thread.data,
-			so_scheduler.pthreads_data);
+		// data, no lookup needed)
+		pthread_param_t *running_pthread_pararm = get_current_thread();
 
 		// Decrease running thread quantum
 		running_pthread_pararm->time_quantum--;
@@ -315,31 +319,26 @@ DWORD so_fork(so_handler *func, unsigned int priority)
 		if (running_pthread_pararm->time_quantum == 0) {
 			set_fastest_thread_after_quantum(
 			    running_pthread_pararm);
-		} else if (!is_empty_list(so_scheduler.ready_threads_pq)) {
-			PQData *max_priority_thread =
-			    peak_pq(so_scheduler.ready_threads_pq);
+		} else if (!is_empty_bitmap_pq(so_scheduler.ready_threads_pq)) {
+			pthread_param_t *ready_pthread_pararm =
+			    container_of_link(
+				peak_bitmap_pq(so_scheduler.ready_threads_pq),
+				pthread_param_t, link);
 
 			// Check if the current thread does not have the
 			// biggest priority
-			if (max_priority_thread->priority >
-			    so_scheduler.running_thread.priority) {
-				// Get replacer's data
-				pthread_param_t *ready_pthread_pararm =
-				    (pthread_param_t *)get_value_hashtable(
-					max_priority_thread->data,
-					so_scheduler.pthreads_data);
+			if (ready_pthread_pararm->priority >
+			    so_scheduler.running_thread->priority) {
+				// Remove new thread from "ready" state
+				pop_fastest_thread();
 
 				// Set new thread to "running" state
-				set_fastest_thread(max_priority_thread);
-
-				// Remove new thread from "ready" state
-				pop_node_pq(so_scheduler.ready_threads_pq);
+				set_fastest_thread(ready_pthread_pararm);
 
 				// Set the previous thread to "ready" state
-				push_node_pq(
+				push_link_bitmap_pq(
 				    so_scheduler.ready_threads_pq,
-				    &running_pthread_pararm->pthread_id,
-				    sizeof(DWORD),
+				    &running_pthread_pararm->link,
 				    running_pthread_pararm->priority);
 
 				// Start execution for the new thread
@@ -360,17 +359,13 @@ DWORD so_fork(so_handler *func, unsigned int priority)
 			}
 		}
 	} else {
-		PQData *max_priority_thread;
-
 		// Mark the first ever fork as true
 		so_scheduler.isAThreadRunning = 1;
 
-		// Set the new thread directly to "running" state
-		max_priority_thread = peak_pq(so_scheduler.ready_threads_pq);
-		set_fastest_thread(max_priority_thread);
+		// Remove the new thread from "ready" state and set it directly
+		// to "running" state
+		set_fastest_thread(pop_fastest_thread());
 
-		// Remove it from "ready" state
-		pop_node_pq(so_scheduler.ready_threads_pq);
 		// Start execution for the new thread
 		if (!ReleaseSemaphore(pthread_param->semaphore, 1, NULL)) {
 			perror("release");
@@ -378,7 +373,7 @@ DWORD so_fork(so_handler *func, unsigned int priority)
 		}
 	}
 
-	return pthread_param->pthread_id;
+	return tid;
 }
 
 /**
@@ -394,8 +389,7 @@ void so_exec(void)
 		return;
 
 	// Decrease current thread's quantum
-	running_pthread_pararm = (pthread_param_t *)get_value_hashtable(
-	    so_scheduler.running_thread.data, so_scheduler.pthreads_data);
+	running_pthread_pararm = get_current_thread();
 	running_pthread_pararm->time_quantum--;
 
 	// Check if thread's quantum expired
@@ -414,7 +408,7 @@ int so_wait(unsigned int io)
 {
 	int ret;
 	pthread_param_t *running_pthread_pararm;
-	waiting_pthread_t waiting_pthread;
+	pthread_param_t *ready_pthread_pararm;
 
 	if (!so_scheduler.isAThreadRunning)
 		return 0;
@@ -423,32 +417,19 @@ int so_wait(unsigned int io)
 		return -1;
 
 	// Get running thread's data
-	running_pthread_pararm = (pthread_param_t *)get_value_hashtable(
-	    so_scheduler.running_thread.data, so_scheduler.pthreads_data);
-
-	// Set "waiting_pthread_t" struct attributes
-	waiting_pthread.pthread_id = running_pthread_pararm->pthread_id;
-	waiting_pthread.priority = running_pthread_pararm->priority;
-	waiting_pthread.io = io;
-
-	// Set thread state to "waiting"
-	add_last_node_list(so_scheduler.waiting_threads, &waiting_pthread,
-			   sizeof(waiting_pthread_t));
-
-	// Check if there are "ready" threads
-	if (!is_empty_list(so_scheduler.ready_threads_pq)) {
-		// Get best thread available
-		PQData *max_priority_thread =
-		    peak_pq(so_scheduler.ready_threads_pq);
-		pthread_param_t *ready_pthread_pararm =
-		    (pthread_param_t *)get_value_hashtable(
-			max_priority_thread->data, so_scheduler.pthreads_data);
+	running_pthread_pararm = get_current_thread();
 
-		// Mark new thread as "running"
-		set_fastest_thread(max_priority_thread);
+	// Set thread state to "waiting" on the "io" device queue
+	running_pthread_pararm->io = io;
+	add_last_link_list(&so_scheduler.waiting_threads[io],
+			   &running_pthread_pararm->link);
+	so_scheduler.num_waiting++;
 
-		// Remove new thread from "ready" state
-		pop_node_pq(so_scheduler.ready_threads_pq);
+	// Check if there are "ready" threads and get best thread available
+	ready_pthread_pararm = pop_fastest_thread();
+	if (ready_pthread_pararm != NULL) {
+		// Mark new thread as "running"
+		set_fastest_thread(ready_pthread_pararm);
 
 		// Start execution for the new thread
 		if (!ReleaseSemaphore(ready_pthread_pararm->semaphore, 1,
@@ -477,68 +458,48 @@ int so_wait(unsigned int io)
  */
 int so_signal(unsigned int io)
 {
-	int ret;
 	pthread_param_t *running_pthread_pararm;
-	PQData *max_priority_thread;
-	Node *thread_data;
-	pthread_param_t *ready_pthread_pararm;
+	pthread_param_t *waiting_pthread_pararm, *ready_pthread_pararm;
+	ListLink *link;
 	int num_threads = 0;
 
 	if (io >= so_scheduler.io)
 		return -1;
 
-	if (!so_scheduler.isAThreadRunning ||
-	    is_empty_list(so_scheduler.waiting_threads))
+	// A signal reschedules as soon as any thread waits, on any device
+	if (!so_scheduler.isAThreadRunning || so_scheduler.num_waiting == 0)
 		return 0;
 
 	// Get "running" thread data
-	running_pthread_pararm = (pthread_param_t *)get_value_hashtable(
-	    so_scheduler.running_thread.data, so_scheduler.pthreads_data);
+	running_pthread_pararm = get_current_thread();
 
 	// Mark "running" thread as "ready"
-	push_node_pq(so_scheduler.ready_threads_pq,
-		     &running_pthread_pararm->pthread_id, sizeof(DWORD),
-		     running_pthread_pararm->priority);
-
-	// Signal all threads that have the "io" signal to be set to "ready"
-	thread_data = pop_node_list(so_scheduler.waiting_threads, &io);
-
-	while (thread_data != NULL) {
-		push_node_pq(
-		    so_scheduler.ready_threads_pq,
-		    &((waiting_pthread_t *)thread_data->data)->pthread_id,
-		    sizeof(DWORD),
-		    ((waiting_pthread_t *)thread_data->data)->priority);
-
-		free(thread_data->data);
-		free(thread_data);
-
-		thread_data = pop_node_list(so_scheduler.waiting_threads, &io);
+	push_link_bitmap_pq(so_scheduler.ready_threads_pq,
+			    &running_pthread_pararm->link,
+			    running_pthread_pararm->priority);
+
+	// Signal all threads waiting on the "io" device to be set to "ready",
+	// the other devices' queues are not touched
+	link = pop_first_link_list(&so_scheduler.waiting_threads[io]);
+	while (link != NULL) {
+		waiting_pthread_pararm =
+		    container_of_link(link, pthread_param_t, link);
+		push_link_bitmap_pq(so_scheduler.ready_threads_pq, link,
+				    waiting_pthread_pararm->priority);
 		num_threads++;
+
+		link = pop_first_link_list(&so_scheduler.waiting_threads[io]);
 	}
+	so_scheduler.num_waiting -= num_threads;
 
-	// Get most important thread data
-	max_priority_thread = peak_pq(so_scheduler.ready_threads_pq);
-	ready_pthread_pararm = (pthread_param_t *)get_value_hashtable(
-	    max_priority_thread->data, so_scheduler.pthreads_data);
+	// Remove the most important thread from "ready" state
+	ready_pthread_pararm = pop_fastest_thread();
 
 	// Mark new thread as "running"
-	set_fastest_thread(max_priority_thread);
-
-	// Remove the new thread from "ready" state
-	pop_node_pq(so_scheduler.ready_threads_pq);
+	set_fastest_thread(ready_pthread_pararm);
 
-	// Start execution for the new thread
-	if (!ReleaseSemaphore(ready_pthread_pararm->semaphore, 1, NULL)) {
-		perror("release");
-		exit(1);
-	}
-	// Stop execution for the old thread
-	ret = WaitForSingleObject(running_pthread_pararm->semaphore, INFINITE);
-	if (ret == WAIT_FAILED) {
-		perror("acquire");
-		exit(1);
-	}
+	// Signal new thread to start execution and old thread to stop
+	switch_thread(running_pthread_pararm, ready_pthread_pararm);
 
 	return num_threads;
 }
@@ -549,29 +510,42 @@ int so_signal(unsigned int io)
  */
 void so_end(void)
 {
-	HANDLE hThread;
 	int ret;
-	Node *curr;
-	// Waits for all ever created threads to finish
-	if (so_scheduler.pthreads_created != NULL) {
-		curr = so_scheduler.pthreads_created->head;
-		while (curr != NULL) {
-			hThread = *(HANDLE *)(curr->data);
-			ret = WaitForSingleObject(hThread, INFINITE);
+	LONG num_live;
+
+	// Waits once for all ever created threads to finish, the last one sets
+	// the end event. A count read under the end lock has no set in flight
+	if (so_scheduler.end_event != NULL) {
+		for (;;) {
+			EnterCriticalSection(&so_scheduler.end_lock);
+			num_live = InterlockedCompareExchange(
+			    &so_scheduler.num_live, 0, 0);
+			LeaveCriticalSection(&so_scheduler.end_lock);
+
+			if (num_live == 0)
+				break;
+
+			ret = WaitForSingleObject(so_scheduler.end_event,
+						  INFINITE);
 			if (ret == WAIT_FAILED) {
 				perror("pthread_join");
 				exit(1);
 			}
-			curr = curr->next;
+		}
+
+		DeleteCriticalSection(&so_scheduler.end_lock);
+
+		if (!CloseHandle(so_scheduler.end_event)) {
+			perror("close");
+			exit(1);
 		}
 	}
 
-	// Free all internal structures
-	free_list(&so_scheduler.pthreads_created);
-	free_list(&so_scheduler.ready_threads_pq);
-	free_list(&so_scheduler.waiting_threads);
-	free_hashtable(&so_scheduler.pthreads_data);
-	free(so_scheduler.running_thread.data);
+	// Free all internal structures, with an arena they are released in one
+	// step together with the arena
+	free_bitmap_pq(&so_scheduler.ready_threads_pq);
+	free_task_table(&so_scheduler.tasks);
+	free_arena(&so_scheduler.arena);
 
 	// Sets all the struct's field to "0" for safety
 	memset(&so_scheduler, 0, sizeof(so_scheduler_t));
@@ -0,0 +1,139 @@
+#include "task_table.h"
+#include <string.h>
+
+#define MIN_TASK_CAPACITY 8
+
+/**
+ * @brief Initializes a table that gives every record a small dense index. The
+ * records never move once allocated, an index that is released is pushed on a
+ * free list and handed out again, together with its record, by the next
+ * allocation.
+ *
+ * @param table to be initialized
+ * @param record_size size of every record
+ * @param capacity initial number of indexes
+ * @param arena that owns the table and its records, NULL to use the heap
+ */
+void initialize_task_table(TaskTable *table, size_t record_size,
+			   unsigned int capacity, Arena *arena)
+{
+	if (table == NULL)
+		return;
+
+	memset(table, 0, sizeof(TaskTable));
+	table->record_size = record_size;
+	table->arena = arena;
+	table->capacity = MIN_TASK_CAPACITY;
+	while (table->capacity < capacity)
+		table->capacity *= 2;
+}
+
+/**
+ * @brief Doubles the number of indexes, the records themselves stay in place.
+ *
+ * @param table instance of the table
+ */
+static void grow_task_table(TaskTable *table)
+{
+	void **records;
+	unsigned int *free_indexes;
+	unsigned int capacity = table->capacity;
+
+	if (table->records != NULL)
+		capacity *= 2;
+
+	records = alloc_arena(table->arena, capacity * sizeof(void *));
+	free_indexes =
+	    alloc_arena(table->arena, capacity * sizeof(unsigned int));
+
+	if (table->records != NULL) {
+		memcpy(records, table->records, table->size * sizeof(void *));
+		memcpy(free_indexes, table->free_indexes,
+		       table->num_free * sizeof(unsigned int));
+	}
+
+	release_arena(table->arena, table->records);
+	release_arena(table->arena, table->free_indexes);
+
+	table->records = records;
+	table->free_indexes = free_indexes;
+	table->capacity = capacity;
+}
+
+/**
+ * @brief Takes an index from the table, a recycled one when there is one.
+ *
+ * @param table instance of the table
+ * @return unsigned int index of a zeroed record
+ */
+unsigned int alloc_task_table(TaskTable *table)
+{
+	unsigned int index;
+
+	if (table->num_free != 0) {
+		index = table->free_indexes[--table->num_free];
+		memset(table->records[index], 0, table->record_size);
+
+		return index;
+	}
+
+	if (table->records == NULL || table->size == table->capacity)
+		grow_task_table(table);
+
+	index = table->size++;
+	table->records[index] =
+	    alloc_arena(table->arena, table->record_size);
+
+	return index;
+}
+
+/**
+ * @brief Gets the record of an index.
+ *
+ * @param table instance of the table
+ * @param index previously returned by "alloc_task_table"
+ * @return void* record of the index or NULL if out of range
+ */
+void *get_task_table(TaskTable *table, unsigned int index)
+{
+	if (table == NULL || index >= table->size)
+		return NULL;
+
+	return table->records[index];
+}
+
+/**
+ * @brief Gives an index back to the table, its record is kept for reuse.
+ *
+ * @param table instance of the table
+ * @param index previously returned by "alloc_task_table"
+ */
+void release_task_table(TaskTable *table, unsigned int index)
+{
+	if (table == NULL || index >= table->size)
+		return;
+
+	table->free_indexes[table->num_free++] = index;
+}
+
+/**
+ * @brief Frees every record and the table, a table owned by an arena is freed
+ * together with the arena.
+ *
+ * @param table instance of the table
+ */
+void free_task_table(TaskTable *table)
+{
+	unsigned int i;
+
+	if (table == NULL)
+		return;
+
+	if (table->arena == NULL)
+		for (i = 0; i < table->size; ++i)
+			free(table->records[i]);
+
+	release_arena(table->arena, table->records);
+	release_arena(table->arena, table->free_indexes);
+	memset(table, 0, sizeof(TaskTable));
+}
@@ -0,0 +1,29 @@
+#ifndef TASK_TABLE_H
+#define TASK_TABLE_H
+
+#include "arena.h"
+
+#define INVALID_TASK_INDEX ((unsigned int)-1)
+
+typedef struct TaskTable {
+	void **records;
+	unsigned int *free_indexes;
+	unsigned int num_free;
+	unsigned int size;
+	unsigned int capacity;
+	size_t record_size;
+	Arena *arena;
+} TaskTable;
+
+void initialize_task_table(TaskTable *table, size_t record_size,
+			   unsigned int capacity, Arena *arena);
+
+unsigned int alloc_task_table(TaskTable *table);
+
+void *get_task_table(TaskTable *table, unsigned int index);
+
+void release_task_table(TaskTable *table, unsigned int index);
+
+void free_task_table(TaskTable *table);
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef TYPED_HASHTABLE_H
+#define TYPED_HASHTABLE_H
+
+#include "arena.h"
+#include <string.h>
+
+#ifdef _MSC_VER
+#define TYPED_INLINE static __inline
+#else
+#define TYPED_INLINE static inline
+#endif
+
+#define TYPED_MIN_CAPACITY 8
+#define TYPED_MAX_LOAD_NUMERATOR 3
+#define TYPED_MAX_LOAD_DENOMINATOR 4
+
+/**
+ * @brief Hash function for unsigned longs, shared with "hash_function_ulong".
+ *
+ * @param x data to be hashed
+ * @return unsigned int new hash
+ */
+TYPED_INLINE unsigned int hash_ulong_typed(unsigned long x)
+{
+	x = ((x >> 16) ^ x) * 0x45d9f3b;
+	x = ((x >> 16) ^ x) * 0x45d9f3b;
+	x = (x >> 16) ^ x;
+
+	return x;
+}
+
+// Equality for keys that can be compared with "=="
+#define EQUAL_SCALAR_TYPED(a, b) ((a) == (b))
+
+/*
+ * Generates a HashTable specialized for one key and value type, named
+ * "name". It works like "HashTable" (open addressing, linear probing, growth
+ * at three quarters, backward-shift deletion and lazily allocated slots), but
+ * the keys and values are stored inline in the slots and "hash" and "equal"
+ * are expanded in place, so a lookup compiles down to direct field compares
+ * instead of calls through function pointers on "void *" data.
+ *
+ * The generated functions are:
+ *	void initialize_<name>(name *ht, unsigned int capacity, Arena *arena)
+ *	void put_<name>(key_type key, value_type value, name *ht)
+ *	value_type *get_<name>(key_type key, name *ht)
+ *	void remove_<name>(key_type key, name *ht)
+ *	void free_<name>(name *ht)
+ */
+#define DECLARE_TYPED_HASHTABLE(name, key_type, value_type, hash, equal) \
+\
+typedef struct name##_slot { \
+	key_type key; \
+	value_type value; \
+	unsigned int hash; \
+	unsigned char used; \
+} name##_slot; \
+\
+typedef struct name { \
+	name##_slot *slots; \
+	unsigned int size; \
+	unsigned int capacity; \
+	Arena *arena; \
+} name; \
+\
+TYPED_INLINE void initialize_##name(name *ht, unsigned int capacity, \
+				    Arena *arena) \
+{ \
+	ht->slots = NULL; \
+	ht->size = 0; \
+	ht->arena = arena; \
+	ht->capacity = TYPED_MIN_CAPACITY; \
+	while (ht->capacity < capacity) \
+		ht->capacity *= 2; \
+} \
+\
+TYPED_INLINE name##_slot *find_slot_##name(key_type key, unsigned int h, \
+					   name *ht) \
+{ \
+	unsigned int mask = ht->capacity - 1; \
+	unsigned int index = h & mask; \
+\
+	while (ht->slots[index].used) { \
+		if (ht->slots[index].hash == h && \
+		    equal(ht->slots[index].key, key)) \
+			break; \
+\
+		index = (index + 1) & mask; \
+	} \
+\
+	return &ht->slots[index]; \
+} \
+\
+TYPED_INLINE void grow_##name(name *ht) \
+{ \
+	unsigned int i, index, mask; \
+	name##_slot *old_slots = ht->slots; \
+	unsigned int old_capacity = ht->capacity; \
+\
+	ht->capacity = old_capacity * 2; \
+	ht->slots = (name##_slot *)alloc_arena( \
+	    ht->arena, ht->capacity * sizeof(name##_slot)); \
+\
+	mask = ht->capacity - 1; \
+	for (i = 0; i < old_capacity; ++i) { \
+		if (!old_slots[i].used) \
+			continue; \
+\
+		index = old_slots[i].hash & mask; \
+		while (ht->slots[index].used) \
+			index = (index + 1) & mask; \
+\
+		ht->slots[index] = old_slots[i]; \
+	} \
+\
+	release_arena(ht->arena, old_slots); \
+} \
+\
+TYPED_INLINE void put_##name(key_type key, value_type value, name *ht) \
+{ \
+	name##_slot *slot; \
+	unsigned int h = hash(key); \
+\
+	if (ht->slots == NULL) \
+		ht->slots = (name##_slot *)alloc_arena( \
+		    ht->arena, ht->capacity * sizeof(name##_slot)); \
+\
+	slot = find_slot_##name(key, h, ht); \
+	if (slot->used) { \
+		slot->value = value; \
+		return; \
+	} \
+\
+	if ((ht->size + 1) * TYPED_MAX_LOAD_DENOMINATOR > \
+	    ht->capacity * TYPED_MAX_LOAD_NUMERATOR) { \
+		grow_##name(ht); \
+		slot = find_slot_##name(key, h, ht); \
+	} \
+\
+	slot->key = key; \
+	slot->value = value; \
+	slot->hash = h; \
+	slot->used = 1; \
+	ht->size++; \
+} \
+\
+TYPED_INLINE value_type *get_##name(key_type key, name *ht) \
+{ \
+	name##_slot *slot; \
+\
+	if (ht->slots == NULL) \
+		return NULL; \
+\
+	slot = find_slot_##name(key, hash(key), ht); \
+	if (!slot->used) \
+		return NULL; \
+\
+	return &slot->value; \
+} \
+\
+TYPED_INLINE void remove_##name(key_type key, name *ht) \
+{ \
+	unsigned int hole, index, home, mask; \
+	name##_slot *slot; \
+\
+	if (ht->slots == NULL) \
+		return; \
+\
+	slot = find_slot_##name(key, hash(key), ht); \
+	if (!slot->used) \
+		return; \
+\
+	mask = ht->capacity - 1; \
+	hole = (unsigned int)(slot - ht->slots); \
+	index = (hole + 1) & mask; \
+\
+	while (ht->slots[index].used) { \
+		home = ht->slots[index].hash & mask; \
+\
+		if (((index - home) & mask) >= ((index - hole) & mask)) { \
+			ht->slots[hole] = ht->slots[index]; \
+			hole = index; \
+		} \
+\
+		index = (index + 1) & mask; \
+	} \
+\
+	memset(&ht->slots[hole], 0, sizeof(name##_slot)); \
+	ht->size--; \
+} \
+\
+TYPED_INLINE void free_##name(name *ht) \
+{ \
+	release_arena(ht->arena, ht->slots); \
+	ht->slots = NULL; \
+	ht->size = 0; \
+}
+
+#endif
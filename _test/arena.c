@@ -0,0 +1,190 @@
+#include "arena.h"
+#include <linux/mempolicy.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define ARENA_ALIGNMENT 16
+#define ALIGN_ARENA(size) \
+	(((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define CHUNK_HEADER_SIZE ALIGN_ARENA(sizeof(ChunkHeader))
+
+// Start of every chunk, a chunk is mapped if it has a size
+typedef struct ChunkHeader {
+	void *next;
+	size_t mapped_size;
+} ChunkHeader;
+
+/**
+ * @brief Initializes an arena that hands out memory from big chunks, the
+ * memory is never given back piece by piece but all at once by "free_arena".
+ *
+ * @param arena to be initialized
+ * @param chunk_size usual size of a chunk
+ */
+void initialize_arena(Arena *arena, size_t chunk_size)
+{
+	if (arena == NULL)
+		return;
+
+	arena->chunks = NULL;
+	arena->cursor = NULL;
+	arena->remaining = 0;
+	arena->chunk_size = ALIGN_ARENA(chunk_size);
+	arena->node = -1;
+}
+
+/**
+ * @brief Places the chunks the arena allocates from now on on a memory node:
+ * they are mapped and the node is made their preferred one before any page
+ * is touched, so the pages land on it whichever thread touches them first.
+ *
+ * @param arena to be bound
+ * @param node number of the memory node, "-1" for the default placement
+ */
+void bind_arena(Arena *arena, int node)
+{
+	if (arena != NULL)
+		arena->node = node;
+}
+
+/**
+ * @brief Maps a chunk whose pages prefer a memory node. The binding is best
+ * effort: without NUMA support or for a node the kernel does not know the
+ * pages are placed as usual.
+ *
+ * @param size size of the chunk
+ * @param node number of the memory node
+ * @return char* start of the chunk
+ */
+static char *map_chunk_arena(size_t size, int node)
+{
+	unsigned long nodemask = 1UL << node;
+	char *chunk;
+
+	chunk = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (chunk == MAP_FAILED)
+		exit(12);
+
+	syscall(SYS_mbind, chunk, size, MPOL_PREFERRED, &nodemask,
+		sizeof(nodemask) * 8 + 1, 0);
+
+	return chunk;
+}
+
+/**
+ * @brief Allocates a chunk and links it in the list of chunks of the arena.
+ *
+ * @param arena owner of the chunk
+ * @param size usable size of the chunk
+ * @return char* usable memory of the chunk
+ */
+static char *add_chunk_arena(Arena *arena, size_t size)
+{
+	ChunkHeader *header;
+	char *chunk;
+
+	if (arena->node >= 0) {
+		chunk = map_chunk_arena(CHUNK_HEADER_SIZE + size, arena->node);
+	} else {
+		chunk = malloc(CHUNK_HEADER_SIZE + size);
+		if (!chunk)
+			exit(12);
+	}
+
+	header = (ChunkHeader *)chunk;
+	header->next = arena->chunks;
+	header->mapped_size = arena->node >= 0 ? CHUNK_HEADER_SIZE + size : 0;
+	arena->chunks = chunk;
+
+	return chunk + CHUNK_HEADER_SIZE;
+}
+
+/**
+ * @brief Allocates zeroed memory from the arena. Without an arena this is a
+ * plain "calloc", so data structures can use it whether or not they were
+ * given an arena.
+ *
+ * @param arena source of the memory, may be NULL
+ * @param size of the memory
+ * @return void* zeroed memory
+ */
+void *alloc_arena(Arena *arena, size_t size)
+{
+	char *data;
+
+	if (arena == NULL) {
+		data = calloc(1, size);
+		if (!data)
+			exit(12);
+
+		return data;
+	}
+
+	size = ALIGN_ARENA(size);
+
+	// Big requests get their own chunk so the current one is not wasted
+	if (size > arena->chunk_size / 4) {
+		data = add_chunk_arena(arena, size);
+	} else {
+		if (size > arena->remaining) {
+			arena->cursor = add_chunk_arena(arena,
+							arena->chunk_size);
+			arena->remaining = arena->chunk_size;
+		}
+
+		data = arena->cursor;
+		arena->cursor += size;
+		arena->remaining -= size;
+	}
+
+	memset(data, 0, size);
+
+	return data;
+}
+
+/**
+ * @brief Releases memory given by "alloc_arena". Memory of an arena stays
+ * until the whole arena is freed, without an arena this is a plain "free".
+ *
+ * @param arena source of the memory, may be NULL
+ * @param data to be released
+ */
+void release_arena(Arena *arena, void *data)
+{
+	if (arena == NULL)
+		free(data);
+}
+
+/**
+ * @brief Frees every chunk of the arena in one pass, the arena stays bound to
+ * its memory node.
+ *
+ * @param arena to be freed
+ */
+void free_arena(Arena *arena)
+{
+	ChunkHeader *chunk, *next;
+
+	if (arena == NULL)
+		return;
+
+	chunk = arena->chunks;
+	while (chunk != NULL) {
+		next = chunk->next;
+		if (chunk->mapped_size == 0) {
+			free(chunk);
+		} else if (munmap(chunk, chunk->mapped_size) == -1) {
+			perror("munmap");
+			exit(1);
+		}
+		chunk = next;
+	}
+
+	arena->chunks = NULL;
+	arena->cursor = NULL;
+	arena->remaining = 0;
+}
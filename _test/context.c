@@ -0,0 +1,175 @@
+#include "context.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#if SO_CONTEXT_ASM
+
+// Saves the callee-saved registers, the SSE and x87 control words on the
+// stack of "from" and restores those of "to", a new context "returns" in
+// "context_trampoline" which calls the entry with its argument
+__asm__(".text\n"
+	".p2align 4\n"
+	".type switch_stack_context, @function\n"
+	"switch_stack_context:\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $8, %rsp\n"
+	"	stmxcsr (%rsp)\n"
+	"	fnstcw 4(%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	ldmxcsr (%rsp)\n"
+	"	fldcw 4(%rsp)\n"
+	"	addq $8, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".size switch_stack_context, .-switch_stack_context\n"
+	".p2align 4\n"
+	".type context_trampoline, @function\n"
+	"context_trampoline:\n"
+	"	movq %r12, %rdi\n"
+	"	callq *%r13\n"
+	"	ud2\n"
+	".size context_trampoline, .-context_trampoline\n");
+
+void switch_stack_context(void **from_stack_pointer, void *to_stack_pointer)
+    __asm__("switch_stack_context");
+void context_trampoline(void) __asm__("context_trampoline");
+
+// Slots pushed by "switch_stack_context", from the lowest address
+enum {
+	SLOT_CONTROL_WORDS,
+	SLOT_R15,
+	SLOT_R14,
+	SLOT_R13,
+	SLOT_R12,
+	SLOT_RBX,
+	SLOT_RBP,
+	SLOT_RETURN,
+	NUM_SLOTS
+};
+
+/**
+ * @brief Prepares a context that runs "entry(arg)" on its own stack the first
+ * time it is switched to, "entry" must never return.
+ *
+ * @param context to be initialized
+ * @param stack lowest address of the stack
+ * @param stack_size size of the stack
+ * @param entry function run by the context
+ * @param arg argument of the function
+ */
+void initialize_context(Context *context, void *stack, size_t stack_size,
+			void (*entry)(void *), void *arg)
+{
+	uint64_t *slots;
+	uintptr_t top = ((uintptr_t)stack + stack_size) & ~(uintptr_t)15;
+
+	// The trampoline is entered with a 16 bytes aligned stack
+	slots = (uint64_t *)(top - NUM_SLOTS * sizeof(uint64_t));
+
+	__asm__ volatile("stmxcsr (%0)\n\tfnstcw 4(%0)"
+			 :
+			 : "r"(&slots[SLOT_CONTROL_WORDS])
+			 : "memory");
+	slots[SLOT_R15] = 0;
+	slots[SLOT_R14] = 0;
+	slots[SLOT_R13] = (uint64_t)(uintptr_t)entry;
+	slots[SLOT_R12] = (uint64_t)(uintptr_t)arg;
+	slots[SLOT_RBX] = 0;
+	slots[SLOT_RBP] = 0;
+	slots[SLOT_RETURN] = (uint64_t)(uintptr_t)context_trampoline;
+
+	context->stack_pointer = slots;
+}
+
+/**
+ * @brief Saves the current context in "from" and resumes "to", returns once
+ * something switches back to "from".
+ *
+ * @param from where the current context is saved
+ * @param to context to be resumed
+ */
+void switch_context(Context *from, Context *to)
+{
+	switch_stack_context(&from->stack_pointer, to->stack_pointer);
+}
+
+#else
+
+/**
+ * @brief Rebuilds the entry and its argument from the "makecontext" integers.
+ *
+ * @param entry_high upper half of the entry address
+ * @param entry_low lower half of the entry address
+ * @param arg_high upper half of the argument
+ * @param arg_low lower half of the argument
+ */
+static void start_context(unsigned int entry_high, unsigned int entry_low,
+			  unsigned int arg_high, unsigned int arg_low)
+{
+	void (*entry)(void *) =
+	    (void (*)(void *))(((uintptr_t)entry_high << 16 << 16) |
+			       entry_low);
+
+	entry((void *)(((uintptr_t)arg_high << 16 << 16) | arg_low));
+	abort();
+}
+
+/**
+ * @brief Prepares a context that runs "entry(arg)" on its own stack the first
+ * time it is switched to, "entry" must never return.
+ *
+ * @param context to be initialized
+ * @param stack lowest address of the stack
+ * @param stack_size size of the stack
+ * @param entry function run by the context
+ * @param arg argument of the function
+ */
+void initialize_context(Context *context, void *stack, size_t stack_size,
+			void (*entry)(void *), void *arg)
+{
+	uintptr_t entry_bits = (uintptr_t)entry;
+	uintptr_t arg_bits = (uintptr_t)arg;
+
+	if (getcontext(&context->ucontext) == -1) {
+		perror("getcontext");
+		exit(1);
+	}
+
+	context->ucontext.uc_stack.ss_sp = stack;
+	context->ucontext.uc_stack.ss_size = stack_size;
+	context->ucontext.uc_link = NULL;
+
+	makecontext(&context->ucontext, (void (*)(void))start_context, 4,
+		    (unsigned int)(entry_bits >> 16 >> 16),
+		    (unsigned int)entry_bits,
+		    (unsigned int)(arg_bits >> 16 >> 16),
+		    (unsigned int)arg_bits);
+}
+
+/**
+ * @brief Saves the current context in "from" and resumes "to", returns once
+ * something switches back to "from".
+ *
+ * @param from where the current context is saved
+ * @param to context to be resumed
+ */
+void switch_context(Context *from, Context *to)
+{
+	if (swapcontext(&from->ucontext, &to->ucontext) == -1) {
+		perror("swapcontext");
+		exit(1);
+	}
+}
+
+#endif
@@ -2,6 +2,9 @@
 
 #define PRIME 7
 #define MAGIC_NUMBER 31
+#define MIN_CAPACITY 8
+#define MAX_LOAD_NUMERATOR 3
+#define MAX_LOAD_DENOMINATOR 4
 
 /**
  * @brief Prints the HashTable.
@@ -12,9 +15,14 @@ void print_hashtable(HashTable *ht)
 {
 	unsigned int i;
 
+	if (ht->slots == NULL)
+		return;
+
 	for (i = 0; i < ht->capacity; ++i)
-		if (!is_empty_list(ht->lists[i]))
-			print_list(ht->lists[i]);
+		if (ht->slots[i].used)
+			ht->print_function(&ht->slots[i].entry);
+
+	printf("\n");
 }
 
 /**
@@ -36,13 +44,7 @@ void print_function_entries(void *data)
  */
 unsigned int hash_function_ulong(void *a)
 {
-	unsigned long x = *(unsigned long *)a;
-	
-	x = ((x >> 16) ^ x) * 0x45d9f3b;
-	x = ((x >> 16) ^ x) * 0x45d9f3b;
-	x = (x >> 16) ^ x;
-	
-	return x;
+	return hash_ulong_typed(*(unsigned long *)a);
 }
 
 /**
@@ -102,9 +104,95 @@ void free_entries(void *data)
 }
 
 /**
- * @brief Initializes the HashTable.
+ * @brief Gives an entry that leaves the HashTable to "free_data". The entries
+ * are stored inline in the slots, so a HashTable on the heap hands over a
+ * copy of the entry that "free_data" frees like every entry it was given
+ * before; an arena HashTable gives the entry itself, it frees nothing.
  *
- * @param capacity total capacity
+ * @param entry entry that leaves the HashTable
+ * @param ht instance of the HashTable
+ */
+static void free_entry_hashtable(Entry *entry, HashTable *ht)
+{
+	Entry *owned_entry;
+
+	if (ht->free_data == NULL)
+		return;
+
+	if (ht->arena != NULL) {
+		ht->free_data(entry);
+		return;
+	}
+
+	owned_entry = malloc(sizeof(Entry));
+	if (!owned_entry)
+		exit(12);
+
+	*owned_entry = *entry;
+	ht->free_data(owned_entry);
+}
+
+/**
+ * @brief Finds the slot of a key, probing linearly from its home slot.
+ *
+ * @param key to be searched
+ * @param hash of the key
+ * @param ht instance of the HashTable
+ * @return Slot* slot holding the key or the empty slot that ends the probe
+ */
+static Slot *find_slot_hashtable(void *key, unsigned int hash, HashTable *ht)
+{
+	unsigned int mask = ht->capacity - 1;
+	unsigned int index = hash & mask;
+
+	while (ht->slots[index].used) {
+		if (ht->slots[index].hash == hash &&
+		    !ht->compare_function(&ht->slots[index].entry, key))
+			break;
+
+		index = (index + 1) & mask;
+	}
+
+	return &ht->slots[index];
+}
+
+/**
+ * @brief Doubles the capacity of the HashTable and moves every entry to its
+ * new slot, the hashes are stored so no key is hashed again.
+ *
+ * @param ht instance of the HashTable
+ */
+static void grow_hashtable(HashTable *ht)
+{
+	unsigned int i, index, mask;
+	Slot *old_slots = ht->slots;
+	unsigned int old_capacity = ht->capacity;
+
+	ht->capacity = old_capacity * 2;
+	ht->slots = alloc_arena(ht->arena, ht->capacity * sizeof(Slot));
+
+	mask = ht->capacity - 1;
+	for (i = 0; i < old_capacity; ++i) {
+		if (!old_slots[i].used)
+			continue;
+
+		index = old_slots[i].hash & mask;
+		while (ht->slots[index].used)
+			index = (index + 1) & mask;
+
+		ht->slots[index] = old_slots[i];
+	}
+
+	release_arena(ht->arena, old_slots);
+}
+
+/**
+ * @brief Initializes the HashTable as a flat array of slots that stores the
+ * entries inline and grows once it is three quarters full. The slots are
+ * allocated in one block by the first insert, so an unused HashTable costs a
+ * single allocation.
+ *
+ * @param capacity initial capacity, rounded up to a power of two
  * @param hash_function used for computing indexes
  * @param compare_function used for comparing keys
  * @param print_function used for printing an entry
@@ -119,24 +207,44 @@ HashTable *initialize_hashtable(unsigned int capacity,
 				void (*free_data)(void *),
 				unsigned char deep_copy_value)
 {
-	unsigned int i;
-	HashTable *ht = (HashTable *)calloc(1, sizeof(HashTable));
-
-	if (!ht)
-		exit(12);
-
-	ht->lists = (LinkedList **)calloc(capacity, sizeof(LinkedList *));
+	return initialize_arena_hashtable(capacity, hash_function,
+					  compare_function, print_function,
+					  free_data, deep_copy_value, NULL);
+}
 
-	if (!ht->lists)
-		exit(12);
+/**
+ * @brief Initializes a HashTable whose memory (table, slots, keys and copied
+ * values) comes from an arena, removing entries never frees memory and
+ * "free_data" should not free the key or the value.
+ *
+ * @param capacity initial capacity, rounded up to a power of two
+ * @param hash_function used for computing indexes
+ * @param compare_function used for comparing keys
+ * @param print_function used for printing an entry
+ * @param free_data used for releasing what an entry owns, may be NULL
+ * @param deep_copy_value flag to perform deep copies for the value
+ * @param arena that owns the memory of the HashTable
+ * @return HashTable* new HashTable instance
+ */
+HashTable *initialize_arena_hashtable(unsigned int capacity,
+				      unsigned int (*hash_function)(void *),
+				      int (*compare_function)(void *, void *),
+				      void (*print_function)(void *),
+				      void (*free_data)(void *),
+				      unsigned char deep_copy_value,
+				      Arena *arena)
+{
+	HashTable *ht = (HashTable *)alloc_arena(arena, sizeof(HashTable));
 
-	for (i = 0; i < capacity; ++i)
-		ht->lists[i] = initialize_list(compare_function, print_function,
-					       free_data);
+	ht->arena = arena;
+	ht->capacity = MIN_CAPACITY;
+	while (ht->capacity < capacity)
+		ht->capacity *= 2;
 
-	ht->capacity = capacity;
 	ht->hash_function = hash_function;
 	ht->compare_function = compare_function;
+	ht->print_function = print_function;
+	ht->free_data = free_data;
 	ht->deep_copy_value = deep_copy_value;
 
 	return ht;
@@ -154,62 +262,96 @@ HashTable *initialize_hashtable(unsigned int capacity,
 void put_hashtable(void *key, unsigned int key_size, void *value,
 		   unsigned int value_size, HashTable *ht)
 {
-	Entry *tmp, entry_m;
-	unsigned int index;
+	Slot *slot;
+	unsigned int hash;
 
 	if (key == NULL || value == NULL || ht == NULL)
 		return;
 
-	index = ht->hash_function(key) % ht->capacity;
+	if (ht->slots == NULL)
+		ht->slots = (Slot *)alloc_arena(ht->arena,
+						ht->capacity * sizeof(Slot));
+
+	hash = ht->hash_function(key);
+	slot = find_slot_hashtable(key, hash, ht);
 
-	tmp = get_value_hashtable(key, ht);
-	if (tmp != NULL) {
-		if (ht->deep_copy_value) {
-			tmp->value = realloc(tmp->value, value_size);
+	if (slot->used) {
+		if (ht->deep_copy_value && ht->arena != NULL) {
+			slot->entry.value = alloc_arena(ht->arena, value_size);
+			memcpy(slot->entry.value, value, value_size);
+		} else if (ht->deep_copy_value) {
+			slot->entry.value =
+			    realloc(slot->entry.value, value_size);
 
-			if (!tmp->value)
+			if (!slot->entry.value)
 				exit(12);
-			memcpy(tmp->value, value, value_size);
+			memcpy(slot->entry.value, value, value_size);
 		} else {
-			tmp->value = value;
+			slot->entry.value = value;
 		}
 		return;
 	}
 
-	entry_m.key = malloc(key_size);
+	if ((ht->size + 1) * MAX_LOAD_DENOMINATOR >
+	    ht->capacity * MAX_LOAD_NUMERATOR) {
+		grow_hashtable(ht);
+		slot = find_slot_hashtable(key, hash, ht);
+	}
 
-	if (!entry_m.key)
-		exit(12);
-	memcpy(entry_m.key, key, key_size);
+	slot->entry.key = alloc_arena(ht->arena, key_size);
+	memcpy(slot->entry.key, key, key_size);
 
 	if (ht->deep_copy_value) {
-		entry_m.value = malloc(value_size);
-
-		if (!entry_m.value)
-			exit(12);
-
-		memcpy(entry_m.value, value, value_size);
+		slot->entry.value = alloc_arena(ht->arena, value_size);
+		memcpy(slot->entry.value, value, value_size);
 	} else {
-		entry_m.value = value;
+		slot->entry.value = value;
 	}
 
-	if (is_empty_list(ht->lists[index]))
-		ht->size++;
-
-	add_first_node_list(ht->lists[index], &entry_m, sizeof(entry_m));
+	slot->hash = hash;
+	slot->used = 1;
+	ht->size++;
 }
 
 /**
- * @brief Pops an entry from the HashTable.
+ * @brief Pops an entry from the HashTable. The entries that follow it in the
+ * same probe run are shifted back so lookups never need tombstones.
  *
  * @param key used to find the entry
  * @param ht instance of the HashTable
  */
 void remove_entry_hashtable(void *key, HashTable *ht)
 {
-	unsigned int index = ht->hash_function(key) % ht->capacity;
+	unsigned int hole, index, home, mask;
+	Slot *slot;
+
+	if (key == NULL || ht == NULL || ht->slots == NULL)
+		return;
+
+	slot = find_slot_hashtable(key, ht->hash_function(key), ht);
+	if (!slot->used)
+		return;
+
+	free_entry_hashtable(&slot->entry, ht);
+
+	mask = ht->capacity - 1;
+	hole = slot - ht->slots;
+	index = (hole + 1) & mask;
+
+	while (ht->slots[index].used) {
+		home = ht->slots[index].hash & mask;
+
+		// Move the entry only if the hole is between its home and it
+		if (((index - home) & mask) >= ((index - hole) & mask)) {
+			ht->slots[hole] = ht->slots[index];
+			hole = index;
+		}
+
+		index = (index + 1) & mask;
+	}
 
-	remove_node_list(ht->lists[index], key);
+	memset(&ht->slots[hole], 0, sizeof(Slot));
+	ht->size--;
 }
 
 /**
@@ -221,22 +363,13 @@ void remove_entry_hashtable(void *key, HashTable *ht)
  */
 int has_value_hashtable(void *key, HashTable *ht)
 {
-	unsigned int index;
-	Node *curr;
-
 	if (key == NULL || ht == NULL)
 		return -1;
 
-	index = ht->hash_function(key) % ht->capacity;
-	curr = ht->lists[index]->head;
-
-	while (curr != NULL) {
-		if (!ht->compare_function(curr->data, key))
-			return 1;
-		curr = curr->next;
-	}
+	if (ht->slots == NULL)
+		return 0;
 
-	return 0;
+	return find_slot_hashtable(key, ht->hash_function(key), ht)->used;
 }
 
 /**
@@ -248,26 +381,21 @@ int has_value_hashtable(void *key, HashTable *ht)
  */
 void *get_value_hashtable(void *key, HashTable *ht)
 {
-	unsigned int index;
-	Node *curr;
+	Slot *slot;
 
-	if (key == NULL || ht == NULL)
+	if (key == NULL || ht == NULL || ht->slots == NULL)
 		return NULL;
 
-	index = ht->hash_function(key) % ht->capacity;
-	curr = ht->lists[index]->head;
-
-	while (curr != NULL) {
-		if (!ht->compare_function(curr->data, key))
-			return ((Entry *)curr->data)->value;
-		curr = curr->next;
-	}
+	slot = find_slot_hashtable(key, ht->hash_function(key), ht);
+	if (!slot->used)
+		return NULL;
 
-	return NULL;
+	return slot->entry.value;
 }
 
 /**
- * @brief Frees the content and the HashTable itself.
+ * @brief Frees the content and the HashTable itself, all the slots are
+ * released at once.
  *
  * @param ht HashTable instance
  */
@@ -278,9 +406,12 @@ void free_hashtable(HashTable **ht)
 	if (ht == NULL || *ht == NULL)
 		return;
 
-	for (i = 0; i < (*ht)->capacity; ++i)
-		free_list(&(*ht)->lists[i]);
+	if ((*ht)->free_data && (*ht)->slots != NULL)
+		for (i = 0; i < (*ht)->capacity; ++i)
+			if ((*ht)->slots[i].used)
+				free_entry_hashtable(&(*ht)->slots[i].entry,
+						     *ht);
 
-	free((*ht)->lists);
-	free(*ht);
+	release_arena((*ht)->arena, (*ht)->slots);
+	release_arena((*ht)->arena, *ht);
 }
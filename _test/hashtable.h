@@ -1,22 +1,33 @@
 #ifndef HASHTABLE_H
 #define HASHTABLE_H
 
+#include "arena.h"
 #include "linkedlist.h"
+#include "typed_hashtable.h"
+
+typedef struct Entry {
+	void *key;
+	void *value;
+} Entry;
+
+typedef struct Slot {
+	Entry entry;
+	unsigned int hash;
+	unsigned char used;
+} Slot;
 
 typedef struct HashTable {
-	LinkedList **lists;
+	Slot *slots;
 	unsigned int size;
 	unsigned int capacity;
 	unsigned int (*hash_function)(void *f);
 	int (*compare_function)(void *f1, void *f2);
+	void (*print_function)(void *f);
+	void (*free_data)(void *f);
 	unsigned char deep_copy_value;
+	Arena *arena;
 } HashTable;
 
-typedef struct Entry {
-	void *key;
-	void *value;
-} Entry;
-
 unsigned int hash_function_ulong(void *a);
 
 void print_hashtable(HashTable *ht);
@@ -44,6 +55,14 @@ HashTable *initialize_hashtable(unsigned int capacity,
 				void (*free_data)(void *),
 				unsigned char deep_copy_value);
 
+HashTable *initialize_arena_hashtable(unsigned int capacity,
+				      unsigned int (*hash_function)(void *),
+				      int (*compare_function)(void *, void *),
+				      void (*print_function)(void *),
+				      void (*free_data)(void *),
+				      unsigned char deep_copy_value,
+				      Arena *arena);
+
 void put_hashtable(void *key, unsigned int key_size, void *value,
 		   unsigned int value_size, HashTable *ht);
 
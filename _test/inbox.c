@@ -0,0 +1,59 @@
+#include "inbox.h"
+
+/**
+ * @brief Initializes an inbox: any thread may push links without a lock and
+ * one consumer at a time takes them all at once, in the order they were
+ * pushed.
+ *
+ * @param inbox to be initialized
+ */
+void initialize_inbox(Inbox *inbox)
+{
+	inbox->head = NULL;
+}
+
+/**
+ * @brief Pushes a link on top of the inbox, it may be called by several
+ * threads at once.
+ *
+ * @param inbox where the link is pushed
+ * @param link intrusive link of the pushed data
+ */
+void push_inbox(Inbox *inbox, ListLink *link)
+{
+	link->next = __atomic_load_n(&inbox->head, __ATOMIC_RELAXED);
+
+	// A failed exchange reloads the head into "link->next"
+	while (!__atomic_compare_exchange_n(&inbox->head, &link->next, link, 1,
+					    __ATOMIC_SEQ_CST,
+					    __ATOMIC_RELAXED))
+		;
+}
+
+/**
+ * @brief Takes every link of the inbox. Only the whole stack is ever taken,
+ * so a link cannot be popped and pushed again under a pusher's feet.
+ *
+ * @param inbox where the links are taken from
+ * @return ListLink* first pushed link, chained to the next ones, or NULL
+ */
+ListLink *take_inbox(Inbox *inbox)
+{
+	ListLink *link, *next, *first = NULL;
+
+	// An empty inbox is checked without writing its cache line
+	if (__atomic_load_n(&inbox->head, __ATOMIC_RELAXED) == NULL)
+		return NULL;
+
+	link = __atomic_exchange_n(&inbox->head, NULL, __ATOMIC_ACQUIRE);
+
+	// The stack is reversed, the oldest link comes first
+	while (link != NULL) {
+		next = link->next;
+		link->next = first;
+		first = link;
+		link = next;
+	}
+
+	return first;
+}
@@ -72,6 +72,32 @@ struct run_test_t test_fun_array[] = {
 	{ test_sched_20 },
 	{ test_sched_21 },
 	{ test_sched_22 },
+
+	/* tests scheduler data structures - see test_data.c */
+	{ test_sched_23 },
+	{ test_sched_24 },
+	{ test_sched_25 },
+	{ test_sched_26 },
+	{ test_sched_27 },
+
+	/* tests scheduler backends - see test_backend.c */
+	{ test_sched_28 },
+	{ test_sched_29 },
+	{ test_sched_30 },
+	{ test_sched_31 },
+	{ test_sched_32 },
+	{ test_sched_33 },
+	{ test_sched_34 },
+	{ test_sched_35 },
+	{ test_sched_36 },
+	{ test_sched_37 },
+	{ test_sched_38 },
+	{ test_sched_39 },
+	{ test_sched_40 },
+	{ test_sched_41 },
+	{ test_sched_42 },
+	{ test_sched_43 },
+	{ test_sched_44 },
 };
 
 /* custom main testing thread */
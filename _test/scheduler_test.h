@@ -40,6 +40,28 @@ extern void test_sched_19(void);
 extern void test_sched_20(void);
 extern void test_sched_21(void);
 extern void test_sched_22(void);
+extern void test_sched_23(void);
+extern void test_sched_24(void);
+extern void test_sched_25(void);
+extern void test_sched_26(void);
+extern void test_sched_27(void);
+extern void test_sched_28(void);
+extern void test_sched_29(void);
+extern void test_sched_30(void);
+extern void test_sched_31(void);
+extern void test_sched_32(void);
+extern void test_sched_33(void);
+extern void test_sched_34(void);
+extern void test_sched_35(void);
+extern void test_sched_36(void);
+extern void test_sched_37(void);
+extern void test_sched_38(void);
+extern void test_sched_39(void);
+extern void test_sched_40(void);
+extern void test_sched_41(void);
+extern void test_sched_42(void);
+extern void test_sched_43(void);
+extern void test_sched_44(void);
 
 /* debugging macro */
 #ifdef SO_VERBOSE_ERROR
@@ -1,174 +1,1407 @@
+#define _GNU_SOURCE
 #include "so_scheduler.h"
-#include "hashtable.h"
+#include "so_scheduler_ex.h"
+#include "context.h"
+#include "handoff.h"
+#include "inbox.h"
 #include "priority_queue.h"
+#include "stack_pool.h"
+#include "task_table.h"
+#include "topology.h"
+#include <limits.h>
 #include <pthread.h>
-#include <semaphore.h>
+#include <sched.h>
 #include <string.h>
+#include <unistd.h>
+
+#define HT_CAPACITY 64
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define GREEN_STACK_SIZE (256 * 1024)
+#define SPIN_START_NS 2000
+
+// Take every internal allocation from an arena released at once by "so_end"
+#ifndef SO_USE_ARENA
+#define SO_USE_ARENA 1
+#endif
+
+#if SO_USE_ARENA
+#define SCHEDULER_ARENA (&so_scheduler.arena)
+#define NODE_ARENA(node) (&(node)->arena)
+#else
+#define SCHEDULER_ARENA NULL
+#define NODE_ARENA(node) NULL
+#endif
 
-#define HT_CAPACITY 1000
+typedef struct pthread_param_t {
+	Handoff handoff;	   // thread wake and park primitive
+	pthread_t pthread_id;	   // thread id (a counter for green tasks)
+	so_handler *func;	   // thread function
+	unsigned int priority;	   // thread priority
+	unsigned int time_quantum; // thread time since running
+	unsigned int io;	   // thread io waiting signal
+	unsigned int index;	   // index in the task table
+	ListLink link;		   // "ready" or "waiting" queue linkage
+	Context context;	   // saved registers of a green task
+	void *stack;		   // stack of a green task
+	size_t stack_size;	   // stack size, "0" for the default
+	struct so_core_t *core;	   // core the thread is scheduled on
+	// Node whose task table holds the thread
+	struct so_node_t *node;
+} pthread_param_t;
+
+// Signal or fork left by a foreign thread for the next scheduling point
+typedef struct so_request_t {
+	ListLink link;		// inbox linkage
+	// Handler of a forked thread, NULL for a signal
+	so_handler *func;
+	unsigned int priority;	// priority of a forked thread
+	unsigned int io;	// io device of a signal
+	unsigned char posted;	// flag set while a signal is in the inbox
+} so_request_t;
+
+// Memory node of a group of cores, the threads forked for its cores are
+// allocated on it and pinned to its CPUs
+typedef struct so_node_t {
+	TaskTable tasks;		// attributes of the node's threads
+	cpu_set_t cpus;			// CPUs the node's threads run on
+	Arena arena;			// memory of the node's task table
+} so_node_t;
+
+// Running slot and ready queue of a core, each core runs one thread at a time
+typedef struct so_core_t {
+	pthread_mutex_t lock;		// guards the running slot and the queue
+	pthread_param_t *running_thread;	// current running thread
+	BitmapPQ *ready_threads_pq;	// ready threads priority queue
+	unsigned char isAThreadRunning; // flag set while a thread is running
+	so_node_t *node;		// memory node of the core
+	so_stats_t stats;		// counters of the core's reschedules
+} so_core_t;
+
+// Kernel thread of the thread pool, it runs one task after another
+typedef struct worker_t {
+	Handoff handoff;		// wakes the worker for a new task
+	pthread_t pthread_id;		// worker thread id
+	size_t stack_size;		// stack size, "0" for the default
+	so_node_t *node;		// node the worker is pinned to
+	pthread_param_t *task;		// task to run, NULL to exit
+	struct worker_t *next_idle;	// next worker in the idle stack
+	struct worker_t *next_worker;	// next worker ever created
+} worker_t;
+
+// How the tasks are executed and how the CPU is passed between them
+typedef struct so_backend_t {
+	// Creates the execution context of a new task, it does not run yet
+	void (*start)(pthread_param_t *task);
+	// Runs a task when no task is running
+	void (*resume)(pthread_param_t *next);
+	// Passes the CPU from a task to another one (NULL if none is ready)
+	void (*switch_to)(pthread_param_t *prev, pthread_param_t *next);
+	// Releases what a finished task owns
+	void (*destroy)(pthread_param_t *task);
+	// Leaves a finished task for the next one (NULL if none is ready)
+	void (*exit)(pthread_param_t *next);
+	// Waits for every task before the scheduler is freed
+	void (*end)(void);
+} so_backend_t;
 
 typedef struct so_scheduler_t {
-	PQData running_thread;		// current running thread
-	HashTable *pthreads_data;	// id to pthread information
-	LinkedList *ready_threads_pq;	// ready threads priority queue
-	LinkedList *waiting_threads;	// waiting threads list
-	LinkedList *pthreads_created;	// list of all threads created
+	// Running slot and ready queue per core
+	so_core_t *cores;
+	// Number of threads running at once
+	unsigned int num_cores;
+	// Flag set if several threads call in
+	unsigned char shared;
+	pthread_mutex_t lock;		// guards the waiting queues
+	pthread_mutex_t tasks_lock;	// guards the task table and the pool
+	Inbox inbox;			// requests of the foreign threads
+	so_request_t signals[SO_MAX_NUM_EVENTS]; // signal request per io
+	so_node_t *nodes;		// memory nodes of the cores
+	unsigned int num_nodes;		// number of memory nodes
+	LinkList waiting_threads[SO_MAX_NUM_EVENTS]; // waiting threads per io
+	unsigned int num_waiting;	// number of waiting threads
+	unsigned int num_live;		// kernel threads not finished yet
 	unsigned int time_quantum;	// time quantum for a thread
 	unsigned int io;		// maximum io time
-	unsigned char isAThreadRunning; // flag for first ever fork
+	const so_backend_t *backend;	// tasks' execution backend
+	HandoffSpin spin;		// learned spin budget of the handoffs
+	// "spin" if threads spin before parking
+	HandoffSpin *park_spin;
+	worker_t *workers;		// every worker of the thread pool
+	worker_t *idle_workers;		// workers waiting for a task
+	// Wakes "so_end" once no thread is live
+	Handoff end_handoff;
+	// Orders the last wake before "so_end"
+	pthread_mutex_t end_lock;
+	Context main_context;		// caller of the green tasks
+	StackPool stacks;		// stacks of the green tasks
+	size_t stack_size;		// default stack size of a task
+	size_t thread_stack_size;	// system default stack of a thread
+	unsigned long num_green_tasks;	// ids of green or external tasks
+	cpu_set_t affinity;		// CPUs the tasks are pinned to
+	// Flag set if the threads are pinned
+	unsigned char pinned;
+	Arena arena;			// memory used until "so_end"
 } so_scheduler_t;
 
-typedef struct pthread_param_t {
-	sem_t semaphore;	   // thread semaphore
-	pthread_t pthread_id;	   // thread id
-	so_handler *func;	   // thread function
-	unsigned int priority;	   // thread priority
-	unsigned int time_quantum; // thread time since running
-} pthread_param_t;
+so_scheduler_t so_scheduler = {0};
+
+// Counters of the last scheduler, the cores count their own until "so_end"
+static so_stats_t so_stats;
+
+// Attributes of the scheduled thread that executes the code
+static __thread pthread_param_t *current_pthread_param;
+
+// Worker of the thread pool that executes the code
+static __thread worker_t *current_worker;
+
+/**
+ * @brief Used by LinkedList to prints "pthread_param_t" struct.
+ *
+ * @param data current node data
+ */
+void print_pthreads_attr(void *data)
+{
+	int pvalue = get_value_handoff(&((pthread_param_t *)data)->handoff);
+
+	printf("pthread_id: %ld, function address: %p, handoff value: %d, "
+	       "priority: %u; ",
+	       ((pthread_param_t *)data)->pthread_id,
+	       ((pthread_param_t *)data)->func, pvalue,
+	       ((pthread_param_t *)data)->priority);
+}
+
+/**
+ * @brief Takes a lock of the scheduler, only needed when several threads
+ * call the scheduler at once (several cores or foreign threads).
+ *
+ * @param mutex lock to take
+ */
+static inline void lock_mutex(pthread_mutex_t *mutex)
+{
+	if (so_scheduler.shared && pthread_mutex_lock(mutex)) {
+		perror("pthread_mutex_lock");
+		exit(1);
+	}
+}
+
+/**
+ * @brief Releases a lock taken by "lock_mutex".
+ *
+ * @param mutex lock to release
+ */
+static inline void unlock_mutex(pthread_mutex_t *mutex)
+{
+	if (so_scheduler.shared && pthread_mutex_unlock(mutex)) {
+		perror("pthread_mutex_unlock");
+		exit(1);
+	}
+}
+
+/**
+ * @brief Takes the lock of the waiting queues. A core's lock may be taken
+ * while it is held, never the other way around.
+ *
+ */
+static inline void lock_scheduler(void)
+{
+	lock_mutex(&so_scheduler.lock);
+}
+
+/**
+ * @brief Releases the lock taken by "lock_scheduler".
+ *
+ */
+static inline void unlock_scheduler(void)
+{
+	unlock_mutex(&so_scheduler.lock);
+}
+
+/**
+ * @brief Takes the lock of a core's running slot and ready queue. A thread
+ * holds at most one core's lock, so the cores never wait on each other.
+ *
+ * @param core "so_core_t" structure of the core
+ */
+static inline void lock_core(so_core_t *core)
+{
+	lock_mutex(&core->lock);
+}
+
+/**
+ * @brief Releases the lock taken by "lock_core".
+ *
+ * @param core "so_core_t" structure of the core
+ */
+static inline void unlock_core(so_core_t *core)
+{
+	unlock_mutex(&core->lock);
+}
+
+/**
+ * @brief Takes the lock of the task table and of the thread pool. It is never
+ * held together with another lock, so creating a thread does not stall the
+ * other scheduling calls.
+ *
+ */
+static inline void lock_tasks(void)
+{
+	lock_mutex(&so_scheduler.tasks_lock);
+}
+
+/**
+ * @brief Releases the lock taken by "lock_tasks".
+ *
+ */
+static inline void unlock_tasks(void)
+{
+	unlock_mutex(&so_scheduler.tasks_lock);
+}
+
+/**
+ * @brief Marks the most important thread of a core as active.
+ *
+ * @param core "so_core_t" structure of the core
+ * @param pthread_param "pthread_param_t" structure of the most important
+ * thread, NULL if no thread is left to run
+ */
+void set_fastest_thread(so_core_t *core, pthread_param_t *pthread_param)
+{
+	core->running_thread = pthread_param;
+
+	// Read without the core's lock by the other cores and foreign threads
+	__atomic_store_n(&core->isAThreadRunning, pthread_param != NULL,
+			 __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Checks without the core's lock if a core has no running thread.
+ *
+ * @param core "so_core_t" structure of the core
+ * @return int "1" if the core is idle, "0" otherwise
+ */
+static inline int is_idle_core(so_core_t *core)
+{
+	return !__atomic_load_n(&core->isAThreadRunning, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Gets the core of the calling thread, a thread that is not scheduled
+ * (or a green task) gets the first core.
+ *
+ * @return so_core_t* core of the calling thread
+ */
+static inline so_core_t *get_current_core(void)
+{
+	if (current_pthread_param != NULL)
+		return current_pthread_param->core;
+
+	return so_scheduler.cores;
+}
+
+/**
+ * @brief Gets the attributes of the calling thread without any lookup, a
+ * thread that is not scheduled (or a green task) gets the "running" thread
+ * of the first core.
+ *
+ * @return pthread_param_t* attributes of the calling thread
+ */
+static inline pthread_param_t *get_current_thread(void)
+{
+	if (current_pthread_param != NULL)
+		return current_pthread_param;
+
+	return so_scheduler.cores->running_thread;
+}
+
+/**
+ * @brief Checks if the caller is a foreign thread, one that calls a shared
+ * scheduler without being scheduled (like an IO completion thread or the
+ * caller of "so_init"). It never holds the "running" state, so it is never
+ * preempted nor parked.
+ *
+ * @return int "1" for a foreign thread, "0" otherwise
+ */
+static inline int is_foreign_thread(void)
+{
+	return so_scheduler.shared && current_pthread_param == NULL;
+}
+
+/**
+ * @brief Removes the most important thread from the "ready" state of a core.
+ *
+ * @param core "so_core_t" structure of the core
+ * @return pthread_param_t* removed thread or NULL if no thread is "ready"
+ */
+pthread_param_t *pop_fastest_thread(so_core_t *core)
+{
+	ListLink *link = pop_link_bitmap_pq(core->ready_threads_pq);
+
+	if (link == NULL)
+		return NULL;
+
+	return container_of_link(link, pthread_param_t, link);
+}
+
+/**
+ * @brief Pins a kernel thread to the CPUs of a memory node.
+ *
+ * @param pthread_id thread id
+ * @param node "so_node_t" structure of the node
+ */
+static void pin_thread(pthread_t pthread_id, so_node_t *node)
+{
+	if (pthread_setaffinity_np(pthread_id, sizeof(cpu_set_t),
+				   &node->cpus)) {
+		perror("pthread_setaffinity_np");
+		exit(1);
+	}
+}
+
+/**
+ * @brief Schedules a thread on a core, a thread that changes memory node is
+ * pinned to the CPUs of its new node.
+ *
+ * @param pthread_param "pthread_param_t" structure of the thread
+ * @param core "so_core_t" structure of the core
+ */
+static void move_thread(pthread_param_t *pthread_param, so_core_t *core)
+{
+	if (so_scheduler.pinned && pthread_param->core->node != core->node)
+		pin_thread(pthread_param->pthread_id, core->node);
+
+	pthread_param->core = core;
+}
+
+/**
+ * @brief Finds the core with the most "ready" threads, each core's queue is
+ * read under its own lock.
+ *
+ * @param thief "so_core_t" structure of the core looking for a thread
+ * @param node "so_node_t" structure of the node of the core, NULL for any
+ * @return so_core_t* busiest core or NULL if no core has "ready" threads
+ */
+static so_core_t *find_busiest_core(so_core_t *thief, so_node_t *node)
+{
+	unsigned int i, size, busiest_size = 0;
+	so_core_t *core, *busiest = NULL;
+
+	for (i = 0; i < so_scheduler.num_cores; ++i) {
+		core = &so_scheduler.cores[i];
+		if (core == thief || (node != NULL && core->node != node))
+			continue;
+
+		lock_core(core);
+		size = core->ready_threads_pq->size;
+		unlock_core(core);
+
+		if (size > busiest_size) {
+			busiest = core;
+			busiest_size = size;
+		}
+	}
+
+	return busiest;
+}
+
+/**
+ * @brief Takes the most important "ready" thread of a core for another core.
+ *
+ * @param from "so_core_t" structure of the core that gives the thread
+ * @param to "so_core_t" structure of the core that takes the thread
+ * @return pthread_param_t* taken thread or NULL if none is left
+ */
+static pthread_param_t *take_thread(so_core_t *from, so_core_t *to)
+{
+	pthread_param_t *taken_pthread_pararm;
+
+	lock_core(from);
+	taken_pthread_pararm = pop_fastest_thread(from);
+	if (taken_pthread_pararm != NULL) {
+		from->stats.steals++;
+		if (from->node != to->node)
+			from->stats.remote_steals++;
+	}
+	unlock_core(from);
+
+	if (taken_pthread_pararm != NULL)
+		move_thread(taken_pthread_pararm, to);
+
+	return taken_pthread_pararm;
+}
+
+/**
+ * @brief Takes the most important "ready" thread of the core with the most
+ * "ready" threads, for a core that has none left. The cores of the same
+ * memory node are searched first, another node's thread is only taken if
+ * none of them has one.
+ *
+ * @param core "so_core_t" structure of the core left without "ready" threads
+ * @return pthread_param_t* stolen thread or NULL if no core has one
+ */
+static pthread_param_t *steal_thread(so_core_t *core)
+{
+	so_core_t *busiest = find_busiest_core(core, core->node);
+
+	if (busiest == NULL && so_scheduler.num_nodes > 1)
+		busiest = find_busiest_core(core, NULL);
+
+	if (busiest == NULL)
+		return NULL;
+
+	return take_thread(busiest, core);
+}
+
+/**
+ * @brief Chooses the core of a thread that becomes "ready": its preferred
+ * core, unless that core is busy and another one is idle, an idle core of
+ * the same memory node first. The cores are read without their locks, the
+ * chosen core may be busy by the time the thread is queued.
+ *
+ * @param preferred "so_core_t" structure of the preferred core
+ * @return so_core_t* chosen core
+ */
+static so_core_t *choose_core(so_core_t *preferred)
+{
+	unsigned int i;
+	so_core_t *core, *idle = NULL;
+
+	if (is_idle_core(preferred))
+		return preferred;
+
+	for (i = 0; i < so_scheduler.num_cores; ++i) {
+		core = &so_scheduler.cores[i];
+		if (!is_idle_core(core))
+			continue;
+
+		if (core->node == preferred->node)
+			return core;
+		if (idle == NULL)
+			idle = core;
+	}
+
+	return idle != NULL ? idle : preferred;
+}
+
+/**
+ * @brief Starts the most important thread of an idle core, with the core's
+ * lock held.
+ *
+ * @param core "so_core_t" structure of the core
+ */
+static void wake_core(so_core_t *core)
+{
+	pthread_param_t *ready_pthread_pararm;
+
+	if (core->isAThreadRunning)
+		return;
+
+	ready_pthread_pararm = pop_fastest_thread(core);
+	set_fastest_thread(core, ready_pthread_pararm);
+	if (ready_pthread_pararm != NULL)
+		so_scheduler.backend->resume(ready_pthread_pararm);
+}
+
+/**
+ * @brief Makes a thread "ready" on a core, an idle core starts it at once.
+ *
+ * @param pthread_param "pthread_param_t" structure of the thread
+ * @param core "so_core_t" structure of the core
+ * @return int "1" if the core was busy, "0" if it started a thread
+ */
+static int push_thread(pthread_param_t *pthread_param, so_core_t *core)
+{
+	int busy;
+
+	lock_core(core);
+	push_link_bitmap_pq(core->ready_threads_pq, &pthread_param->link,
+			    pthread_param->priority);
+	busy = core->isAThreadRunning;
+	wake_core(core);
+	unlock_core(core);
+
+	return busy;
+}
+
+/**
+ * @brief Hands the most important "ready" thread of a busy core to an idle
+ * core. A core that went idle after it looked for "ready" threads is found
+ * here: either it saw this core's queue or this core sees it idle.
+ *
+ * @param core "so_core_t" structure of the busy core
+ */
+static void share_thread(so_core_t *core)
+{
+	so_core_t *idle;
+	pthread_param_t *shared_pthread_pararm;
+
+	while (so_scheduler.num_cores > 1) {
+		idle = choose_core(core);
+		if (idle == core)
+			return;
+
+		shared_pthread_pararm = take_thread(core, idle);
+		if (shared_pthread_pararm == NULL ||
+		    !push_thread(shared_pthread_pararm, idle))
+			return;
+
+		// The idle core got busy first, the thread waits in its queue
+		core = idle;
+	}
+}
+
+/**
+ * @brief Makes a thread "ready" on its chosen core, an idle core starts it at
+ * once.
+ *
+ * @param pthread_param "pthread_param_t" structure of the thread
+ * @param preferred "so_core_t" structure of the preferred core
+ */
+static void queue_thread(pthread_param_t *pthread_param, so_core_t *preferred)
+{
+	so_core_t *core = choose_core(preferred);
+
+	move_thread(pthread_param, core);
+	if (push_thread(pthread_param, core))
+		share_thread(core);
+}
+
+/**
+ * @brief Creates a thread in a free entry of the task table of a core's
+ * memory node, it waits to be started on that node.
+ *
+ * @param func function attributed to the new thread
+ * @param priority of the new thread
+ * @param stack_size stack size of the new thread, "0" for the scheduler's
+ * @param core "so_core_t" structure of the core expected to run the thread
+ * @return pthread_param_t* "pthread_param_t" structure of the new thread
+ */
+static pthread_param_t *new_thread(so_handler *func, unsigned int priority,
+				   size_t stack_size, so_core_t *core)
+{
+	pthread_param_t *pthread_param;
+	unsigned int index;
+
+	lock_tasks();
+
+	// Set thread parameters in a free entry of the task table
+	index = alloc_task_table(&core->node->tasks);
+	pthread_param = get_task_table(&core->node->tasks, index);
+	pthread_param->index = index;
+	pthread_param->core = core;
+	pthread_param->node = core->node;
+	pthread_param->func = func;
+	pthread_param->priority = priority;
+	pthread_param->time_quantum = so_scheduler.time_quantum;
+	pthread_param->stack_size =
+	    stack_size ? stack_size : so_scheduler.stack_size;
+
+	// Create thread, it waits to be started
+	so_scheduler.backend->start(pthread_param);
+
+	unlock_tasks();
+
+	return pthread_param;
+}
+
+/**
+ * @brief Takes every thread waiting for an io device out of its queue, with
+ * the scheduler lock held. The other devices' queues are not touched.
+ *
+ * @param io device of the signal
+ * @param woken list that gets the threads, in the order they waited
+ * @return int number of threads taken
+ */
+static int take_waiting_threads(unsigned int io, LinkList *woken)
+{
+	*woken = so_scheduler.waiting_threads[io];
+	initialize_link_list(&so_scheduler.waiting_threads[io]);
+	so_scheduler.num_waiting -= woken->size;
+
+	return woken->size;
+}
+
+/**
+ * @brief Marks every thread waiting for an io device as "ready". A thread
+ * goes back to its last core, or to an idle core that starts it at once.
+ *
+ * @param io device of the signal
+ * @return int number of threads woken
+ */
+static int wake_waiting_threads(unsigned int io)
+{
+	int num_threads;
+	LinkList woken;
+	ListLink *link;
+	pthread_param_t *waiting_pthread_pararm;
+
+	lock_scheduler();
+	num_threads = take_waiting_threads(io, &woken);
+	unlock_scheduler();
+
+	while ((link = pop_first_link_list(&woken)) != NULL) {
+		waiting_pthread_pararm =
+		    container_of_link(link, pthread_param_t, link);
+		queue_thread(waiting_pthread_pararm,
+			     waiting_pthread_pararm->core);
+	}
+
+	return num_threads;
+}
+
+/**
+ * @brief Runs the requests the foreign threads left in the inbox, oldest
+ * first, without any lock held. The woken and forked threads preempt nobody
+ * at once, the caller's scheduling point does it for its core.
+ *
+ * @param core "so_core_t" structure of the draining core, preferred by the
+ * forked threads
+ */
+static void drain_inbox(so_core_t *core)
+{
+	ListLink *link, *next_link;
+	so_request_t *request;
+
+	for (link = take_inbox(&so_scheduler.inbox); link; link = next_link) {
+		next_link = link->next;
+		request = container_of_link(link, so_request_t, link);
+
+		// A signal is posted again once it is taken, the threads
+		// that wait from now on need a new one
+		if (request->func == NULL) {
+			__atomic_exchange_n(&request->posted, 0,
+					    __ATOMIC_ACQ_REL);
+			wake_waiting_threads(request->io);
+			continue;
+		}
+
+		queue_thread(new_thread(request->func, request->priority, 0,
+					choose_core(core)),
+			     core);
+		free(request);
+	}
+}
+
+/**
+ * @brief Gives the "running" state of a core to its next thread when the
+ * running thread waits or ends, with the core's lock held. A core left idle
+ * is filled by "fill_core" once its lock is released.
+ *
+ * @param core "so_core_t" structure of the core
+ * @return pthread_param_t* next thread or NULL if no thread is "ready"
+ */
+static pthread_param_t *leave_core(so_core_t *core)
+{
+	pthread_param_t *ready_pthread_pararm = pop_fastest_thread(core);
+
+	set_fastest_thread(core, ready_pthread_pararm);
+
+	return ready_pthread_pararm;
+}
+
+/**
+ * @brief Looks for work for a core that went idle, without any lock held: the
+ * inbox is drained once more, then the core steals a thread.
+ *
+ * @param core "so_core_t" structure of the core
+ */
+static void fill_core(so_core_t *core)
+{
+	pthread_param_t *stolen_pthread_pararm;
+
+	// A request posted while the core still looked busy is left to the
+	// core, pairs with the fence of "post_request": either the core sees
+	// the request or the poster sees the idle core. A drained thread may
+	// be started on this core, it is already resumed
+	if (so_scheduler.shared) {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		drain_inbox(core);
+	}
+
+	// Another core may have started a thread here since it went idle
+	if (so_scheduler.num_cores == 1 || !is_idle_core(core))
+		return;
+
+	stolen_pthread_pararm = steal_thread(core);
+	if (stolen_pthread_pararm != NULL &&
+	    push_thread(stolen_pthread_pararm, core))
+		share_thread(core);
+}
+
+/**
+ * @brief Gives the "running" state of a finished thread to the next thread and
+ * recycles the finished thread.
+ *
+ * @param pthread_param "pthread_param_t" structure of the finished thread
+ * @return pthread_param_t* next thread or NULL if no thread is "ready"
+ */
+static pthread_param_t *finish_thread(pthread_param_t *pthread_param)
+{
+	pthread_param_t *ready_pthread_pararm;
+	so_core_t *core = pthread_param->core;
+
+	if (so_scheduler.shared)
+		drain_inbox(core);
+
+	// Gives "running" state to next thread of the core based on priority
+	lock_core(core);
+	ready_pthread_pararm = leave_core(core);
+	unlock_core(core);
+	if (ready_pthread_pararm == NULL)
+		fill_core(core);
+
+	// No thread will signal a finished thread again, its index and
+	// attributes are recycled before the next thread is resumed
+	lock_tasks();
+	so_scheduler.backend->destroy(pthread_param);
+	release_task_table(&pthread_param->node->tasks, pthread_param->index);
+	unlock_tasks();
+
+	return ready_pthread_pararm;
+}
+
+/**
+ * @brief Runs the function of a thread, then gives the "running" state to the
+ * next thread and recycles the finished thread.
+ *
+ * @param pthread_param "pthread_param_t" structure of the thread
+ */
+static void run_thread(pthread_param_t *pthread_param)
+{
+	// Run associated function
+	pthread_param->func(pthread_param->priority);
+
+	// Set next running thread as active
+	so_scheduler.backend->exit(finish_thread(pthread_param));
+}
+
+/**
+ * @brief Helper function used by a newly created thread. The thread waits to be
+ * started, computes its function and lets the next thread take charge after.
+ *
+ * @param data "pthread_param_t" structure will be passed
+ * @return void* NULL
+ */
+void *start_thread(void *data)
+{
+	pthread_param_t *pthread_param = (pthread_param_t *)data;
+
+	// Remember own attributes for the scheduler calls made by the handler
+	current_pthread_param = pthread_param;
+
+	// Waits until another thread signals that its his turn
+	park_handoff(&pthread_param->handoff, so_scheduler.park_spin);
+
+	run_thread(pthread_param);
+
+	// The last thread to finish wakes "so_end", nothing of the scheduler is
+	// touched after it is counted out. The end lock keeps "so_end" from
+	// freeing the handoff between the count and the wake
+	if (pthread_mutex_lock(&so_scheduler.end_lock)) {
+		perror("pthread_mutex_lock");
+		exit(1);
+	}
+	if (!__atomic_sub_fetch(&so_scheduler.num_live, 1, __ATOMIC_ACQ_REL))
+		wake_handoff(&so_scheduler.end_handoff);
+	if (pthread_mutex_unlock(&so_scheduler.end_lock)) {
+		perror("pthread_mutex_unlock");
+		exit(1);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Reads the stack size a kernel thread gets by default.
+ *
+ * @return size_t the default stack size
+ */
+static size_t default_stack_size(void)
+{
+	pthread_attr_t attr;
+	size_t stack_size;
+
+	if (pthread_attr_init(&attr) ||
+	    pthread_attr_getstacksize(&attr, &stack_size) ||
+	    pthread_attr_destroy(&attr)) {
+		perror("pthread_attr_getstacksize");
+		exit(1);
+	}
+
+	return stack_size;
+}
+
+/**
+ * @brief Creates a kernel thread with a given stack size, pinned to the CPUs
+ * of a memory node if the threads are pinned.
+ *
+ * @param pthread_id where the thread id is stored
+ * @param stack_size size of the stack, "0" for the system default
+ * @param node "so_node_t" structure of the node the thread runs on
+ * @param routine function run by the thread
+ * @param arg argument of the function
+ */
+static void create_thread(pthread_t *pthread_id, size_t stack_size,
+			  so_node_t *node, void *(*routine)(void *), void *arg)
+{
+	pthread_attr_t attr;
+
+	if (stack_size == 0 && !so_scheduler.pinned) {
+		if (pthread_create(pthread_id, NULL, routine, arg)) {
+			perror("pthread_create");
+			exit(1);
+		}
+		return;
+	}
+
+	if (stack_size != 0 && stack_size < (size_t)PTHREAD_STACK_MIN)
+		stack_size = PTHREAD_STACK_MIN;
+
+	if (pthread_attr_init(&attr) ||
+	    (stack_size != 0 &&
+	     pthread_attr_setstacksize(&attr, stack_size)) ||
+	    (so_scheduler.pinned &&
+	     pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t),
+					 &node->cpus)) ||
+	    pthread_create(pthread_id, &attr, routine, arg) ||
+	    pthread_attr_destroy(&attr)) {
+		perror("pthread_create");
+		exit(1);
+	}
+}
+
+/**
+ * @brief Creates a kernel thread that waits on its handoff to be started.
+ *
+ * @param task "pthread_param_t" structure of the new thread
+ */
+static void start_kernel(pthread_param_t *task)
+{
+	// Initialize thread handoff
+	initialize_handoff(&task->handoff);
+
+	// Create thread, it is counted out by itself instead of being joined
+	__atomic_add_fetch(&so_scheduler.num_live, 1, __ATOMIC_RELAXED);
+	create_thread(&task->pthread_id, task->stack_size, task->core->node,
+		      start_thread, task);
+	if (pthread_detach(task->pthread_id)) {
+		perror("pthread_detach");
+		exit(1);
+	}
+}
+
+/**
+ * @brief Signals a kernel thread to start execution.
+ *
+ * @param next "pthread_param_t" structure of the thread
+ */
+static void resume_kernel(pthread_param_t *next)
+{
+	wake_handoff(&next->handoff);
+}
+
+/**
+ * @brief Signals the next kernel thread to start execution and blocks the
+ * previous one until it is signaled again.
+ *
+ * @param prev "pthread_param_t" structure of the calling thread
+ * @param next "pthread_param_t" structure of the next thread, may be NULL
+ */
+static void switch_kernel(pthread_param_t *prev, pthread_param_t *next)
+{
+	// Signal new thread to start execution and old thread to stop
+	switch_handoff(&prev->handoff, next != NULL ? &next->handoff : NULL,
+		       so_scheduler.park_spin);
+}
+
+/**
+ * @brief Destroys the handoff of a finished kernel thread.
+ *
+ * @param task "pthread_param_t" structure of the thread
+ */
+static void destroy_kernel(pthread_param_t *task)
+{
+	destroy_handoff(&task->handoff);
+}
+
+/**
+ * @brief Signals the next kernel thread before the finished one returns.
+ *
+ * @param next "pthread_param_t" structure of the next thread, may be NULL
+ */
+static void exit_kernel(pthread_param_t *next)
+{
+	if (next != NULL)
+		resume_kernel(next);
+}
+
+/**
+ * @brief Waits until every kernel thread ever created finished, the last one
+ * wakes the end handoff.
+ *
+ */
+static void end_kernel(void)
+{
+	unsigned int num_live;
+
+	for (;;) {
+		// A count read under the end lock has no wake left in flight
+		if (pthread_mutex_lock(&so_scheduler.end_lock)) {
+			perror("pthread_mutex_lock");
+			exit(1);
+		}
+		num_live = __atomic_load_n(&so_scheduler.num_live,
+					   __ATOMIC_ACQUIRE);
+		if (pthread_mutex_unlock(&so_scheduler.end_lock)) {
+			perror("pthread_mutex_unlock");
+			exit(1);
+		}
+
+		if (num_live == 0)
+			break;
+
+		park_handoff(&so_scheduler.end_handoff, NULL);
+	}
+}
+
+/**
+ * @brief Helper function used by a worker of the thread pool. The worker runs
+ * the tasks it is given, as "start_thread" would, until it is told to exit.
+ *
+ * @param data "worker_t" structure of the worker
+ * @return void* NULL
+ */
+static void *start_worker(void *data)
+{
+	worker_t *worker = (worker_t *)data;
+
+	current_worker = worker;
+
+	for (;;) {
+		// Waits until a task is given (the first one is given at once)
+		park_handoff(&worker->handoff, NULL);
+		if (worker->task == NULL)
+			break;
+
+		start_thread(worker->task);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Checks if the stack of a worker is big enough for a task, a "0"
+ * size stands for the system default of a thread.
+ *
+ * @param worker "worker_t" structure of the worker
+ * @param stack_size stack size of the task, "0" for the system default
+ * @return int "1" if the worker can run the task, "0" otherwise
+ */
+static int fits_worker(worker_t *worker, size_t stack_size)
+{
+	size_t worker_stack_size = worker->stack_size;
+
+	if (worker_stack_size == 0)
+		worker_stack_size = so_scheduler.thread_stack_size;
+	if (stack_size == 0)
+		stack_size = so_scheduler.thread_stack_size;
+
+	return worker_stack_size >= stack_size;
+}
+
+/**
+ * @brief Finds an idle worker with a big enough stack for a task.
+ *
+ * @param stack_size stack size of the task, "0" for the system default
+ * @param node "so_node_t" structure of the worker's node, NULL for any
+ * @return worker_t** link to the worker in the idle list, to NULL if none
+ */
+static worker_t **find_worker(size_t stack_size, so_node_t *node)
+{
+	worker_t **idle = &so_scheduler.idle_workers;
+
+	while (*idle != NULL && (!fits_worker(*idle, stack_size) ||
+				 (node != NULL && (*idle)->node != node)))
+		idle = &(*idle)->next_idle;
+
+	return idle;
+}
+
+/**
+ * @brief Gives a new task to an idle worker with a big enough stack, one of
+ * the task's memory node first, a new worker is only created when none is
+ * idle. The task is identified by its worker's id.
+ *
+ * @param task "pthread_param_t" structure of the new thread
+ */
+static void start_pool(pthread_param_t *task)
+{
+	so_node_t *node = task->core->node;
+	worker_t **idle = find_worker(task->stack_size, node);
+	worker_t *worker;
+
+	// Initialize thread handoff
+	initialize_handoff(&task->handoff);
+
+	if (*idle == NULL && so_scheduler.num_nodes > 1)
+		idle = find_worker(task->stack_size, NULL);
+
+	worker = *idle;
+	__atomic_add_fetch(&so_scheduler.num_live, 1, __ATOMIC_RELAXED);
+	if (worker != NULL) {
+		*idle = worker->next_idle;
+		if (worker->node != node) {
+			pin_thread(worker->pthread_id, node);
+			worker->node = node;
+		}
+		worker->task = task;
+		task->pthread_id = worker->pthread_id;
+		wake_handoff(&worker->handoff);
+		return;
+	}
+
+	worker = alloc_arena(SCHEDULER_ARENA, sizeof(worker_t));
+	initialize_handoff(&worker->handoff);
+	worker->stack_size = task->stack_size;
+	worker->node = node;
+	worker->task = task;
+	wake_handoff(&worker->handoff);
+
+	// Create thread
+	create_thread(&worker->pthread_id, worker->stack_size, node,
+		      start_worker, worker);
+	task->pthread_id = worker->pthread_id;
+
+	worker->next_worker = so_scheduler.workers;
+	so_scheduler.workers = worker;
+}
+
+/**
+ * @brief Puts the worker of a finished task back in the pool and signals the
+ * next thread.
+ *
+ * @param next "pthread_param_t" structure of the next thread, may be NULL
+ */
+static void exit_pool(pthread_param_t *next)
+{
+	worker_t *worker = current_worker;
+
+	// The worker is pushed before the next thread is resumed
+	lock_tasks();
+	worker->next_idle = so_scheduler.idle_workers;
+	so_scheduler.idle_workers = worker;
+	unlock_tasks();
+
+	if (next != NULL)
+		resume_kernel(next);
+}
+
+/**
+ * @brief Waits until every task finished like "end_kernel", then tells the
+ * idle workers to exit and joins them once.
+ *
+ */
+static void end_pool(void)
+{
+	worker_t *worker, *next_worker;
+
+	end_kernel();
+
+	for (worker = so_scheduler.workers; worker; worker = next_worker) {
+		next_worker = worker->next_worker;
+
+		worker->task = NULL;
+		wake_handoff(&worker->handoff);
+		if (pthread_join(worker->pthread_id, NULL)) {
+			perror("pthread_join");
+			exit(1);
+		}
+
+		destroy_handoff(&worker->handoff);
+		release_arena(SCHEDULER_ARENA, worker);
+	}
+}
+
+/**
+ * @brief Entry of a green task's context, it never returns since the finished
+ * task switches to the next one.
+ *
+ * @param data "pthread_param_t" structure of the task
+ */
+static void start_green_thread(void *data)
+{
+	run_thread((pthread_param_t *)data);
+}
 
-typedef struct waiting_pthread_t {
-	pthread_t pthread_id;  // thread id
-	unsigned int priority; // thread priority
-	unsigned int io;       // thread io waiting signal
-} waiting_pthread_t;
+/**
+ * @brief Gives a green task an id, a stack from the stack pool and a context
+ * that starts in "start_green_thread".
+ *
+ * @param task "pthread_param_t" structure of the new task
+ */
+static void start_green(pthread_param_t *task)
+{
+	task->pthread_id = (pthread_t)++so_scheduler.num_green_tasks;
 
-so_scheduler_t so_scheduler = {0};
+	task->stack_size = size_stack_pool(task->stack_size ? task->stack_size
+							    : GREEN_STACK_SIZE);
+	task->stack = alloc_stack_pool(&so_scheduler.stacks, task->stack_size);
+
+	initialize_context(&task->context, task->stack, task->stack_size,
+			   start_green_thread, task);
+}
 
 /**
- * @brief Used in HashTable to compare keys based on pthread.
+ * @brief Runs the green tasks on the calling thread, it returns once no task
+ * is left to run.
  *
- * @param a HashTable current key represented as an "Entry" struct
- * @param b key to be searched
- * @return int "0" on success
+ * @param next "pthread_param_t" structure of the first task
  */
-int compare_pthreads_attr(void *a, void *b)
+static void resume_green(pthread_param_t *next)
 {
-	return !(*((pthread_t *)((Entry *)a)->key) == *(pthread_t *)b);
+	cpu_set_t affinity;
+	pthread_t self = pthread_self();
+
+	// The caller runs the tasks, it is pinned only until they are done
+	if (so_scheduler.pinned &&
+	    (pthread_getaffinity_np(self, sizeof(cpu_set_t), &affinity) ||
+	     pthread_setaffinity_np(self, sizeof(cpu_set_t),
+				    &so_scheduler.affinity))) {
+		perror("pthread_setaffinity_np");
+		exit(1);
+	}
+
+	switch_context(&so_scheduler.main_context, &next->context);
+
+	if (so_scheduler.pinned &&
+	    pthread_setaffinity_np(self, sizeof(cpu_set_t), &affinity)) {
+		perror("pthread_setaffinity_np");
+		exit(1);
+	}
 }
 
 /**
- * @brief Used in LinkedList to compare node data based on thread id.
+ * @brief Saves the registers of a green task and restores the next one, the
+ * caller of the tasks is resumed if no task is ready.
  *
- * @param a List current node represented as a "waiting_pthread_t" struct
- * @param b thread node to be searched
- * @return int "0" on success
+ * @param prev "pthread_param_t" structure of the calling task
+ * @param next "pthread_param_t" structure of the next task, may be NULL
  */
-int compare_io_signal_thread(void *a, void *b)
+static void switch_green(pthread_param_t *prev, pthread_param_t *next)
 {
-	return !(((waiting_pthread_t *)a)->io == *(unsigned int *)b);
+	if (next == NULL)
+		switch_context(&prev->context, &so_scheduler.main_context);
+	else
+		switch_context(&prev->context, &next->context);
 }
 
 /**
- * @brief Used by LinkedList to prints "waiting_pthread_t" struct.
+ * @brief Keeps the stack of a finished green task for the next task, it is
+ * only reused after the finished task has switched away from it.
  *
- * @param data current node data
+ * @param task "pthread_param_t" structure of the task
  */
-void print_waiting_pthread(void *data)
+static void destroy_green(pthread_param_t *task)
 {
-	printf("pthread id: %lu, io: %u, priority: %u; ",
-	       ((waiting_pthread_t *)data)->pthread_id,
-	       ((waiting_pthread_t *)data)->io,
-	       ((waiting_pthread_t *)data)->priority);
+	release_stack_pool(&so_scheduler.stacks, task->stack, task->stack_size);
+	task->stack = NULL;
 }
 
 /**
- * @brief Used by LinkedList to prints "pthread_param_t" struct.
+ * @brief Leaves a finished green task for good.
  *
- * @param data current node data
+ * @param next "pthread_param_t" structure of the next task, may be NULL
  */
-void print_pthreads_attr(void *data)
+static void exit_green(pthread_param_t *next)
 {
-	int rc, pvalue;
+	Context finished;
 
-	rc = sem_getvalue(&((pthread_param_t *)data)->semaphore, &pvalue);
-	if (rc == -1) {
-		perror("sem_getvalue");
-		exit(1);
+	if (next == NULL)
+		switch_context(&finished, &so_scheduler.main_context);
+	else
+		switch_context(&finished, &next->context);
+}
+
+/**
+ * @brief Unmaps the stacks of the green tasks, the tasks still waiting for a
+ * signal are never resumed.
+ *
+ */
+static void end_green(void)
+{
+	unsigned int i;
+	pthread_param_t *task;
+
+	// Green tasks run on a single core, so on a single node
+	for (i = 0; i < so_scheduler.nodes[0].tasks.size; ++i) {
+		task = get_task_table(&so_scheduler.nodes[0].tasks, i);
+		release_stack_pool(&so_scheduler.stacks, task->stack,
+				   task->stack_size);
 	}
 
-	printf("pthread_id: %ld, function address: %p, semaphore value: %d, "
-	       "priority: %u; ",
-	       ((pthread_param_t *)data)->pthread_id,
-	       ((pthread_param_t *)data)->func, pvalue,
-	       ((pthread_param_t *)data)->priority);
+	free_stack_pool(&so_scheduler.stacks);
 }
 
 /**
- * @brief Used by HashTable to free all entries where the key is a thread id and
- * the value a "pthread_param_t" struct.
+ * @brief Gives an external task an id, the caller of the scheduler runs it.
  *
- * @param data current entry
+ * @param task "pthread_param_t" structure of the new task
  */
-void free_entries_pthreads_attr(void *data)
+static void start_external(pthread_param_t *task)
 {
-	Entry *entry;
-
-	if (data == NULL)
-		return;
+	task->pthread_id = (pthread_t)++so_scheduler.num_green_tasks;
+}
 
-	entry = (Entry *)data;
+/**
+ * @brief Does nothing, the caller resumes the task found by "so_running".
+ *
+ * @param task "pthread_param_t" structure of a task, may be NULL
+ */
+static void skip_external(pthread_param_t *task)
+{
+	(void)task;
+}
 
-	if (sem_destroy(&((pthread_param_t *)entry->value)->semaphore) == -1) {
-		perror("destroy");
-		exit(1);
-	};
+/**
+ * @brief Does nothing, the caller resumes the task found by "so_running".
+ *
+ * @param prev "pthread_param_t" structure of the calling task
+ * @param next "pthread_param_t" structure of the next task, may be NULL
+ */
+static void switch_external(pthread_param_t *prev, pthread_param_t *next)
+{
+	(void)prev;
+	(void)next;
+}
 
-	free(entry->key);
-	free(entry->value);
-	free(entry);
+/**
+ * @brief Does nothing, the tasks still waiting for a signal are dropped by
+ * their caller.
+ *
+ */
+static void end_external(void)
+{
 }
 
+static const so_backend_t kernel_backend = {
+	start_kernel, resume_kernel, switch_kernel,
+	destroy_kernel, exit_kernel, end_kernel,
+};
+
+static const so_backend_t pool_backend = {
+	start_pool, resume_kernel, switch_kernel,
+	destroy_kernel, exit_pool, end_pool,
+};
+
+static const so_backend_t green_backend = {
+	start_green, resume_green, switch_green,
+	destroy_green, exit_green, end_green,
+};
+
+static const so_backend_t external_backend = {
+	start_external, skip_external, switch_external,
+	skip_external, skip_external, end_external,
+};
+
 /**
- * @brief Marks the most important thread as active.
+ * @brief Passes the CPU from the running thread to the thread chosen to run
+ * next. When the running thread was chosen again it simply keeps running, no
+ * handoff (and no system call) is made. It is called with the core's lock
+ * held and releases it before the handoff, then an idle core is filled and a
+ * busy one shares its "ready" threads with the idle cores.
  *
- * @param max_priority_thread "PQData" structure of the most important thread
+ * @param core "so_core_t" structure of the core
+ * @param prev "pthread_param_t" structure of the running thread
+ * @param next "pthread_param_t" structure of the next thread, may be NULL
  */
-void set_fastest_thread(PQData *max_priority_thread)
+static void switch_thread(so_core_t *core, pthread_param_t *prev,
+			  pthread_param_t *next)
 {
-	memcpy(so_scheduler.running_thread.data, max_priority_thread->data,
-	       sizeof(pthread_t));
-	so_scheduler.running_thread.priority = max_priority_thread->priority;
+	if (prev == next) {
+		core->stats.skipped_switches++;
+		unlock_core(core);
+		return;
+	}
+
+	core->stats.switches++;
+	unlock_core(core);
+
+	if (next == NULL)
+		fill_core(core);
+	else
+		share_thread(core);
+
+	so_scheduler.backend->switch_to(prev, next);
 }
 
 /**
- * @brief Set the running thread after the current thread's quantum expired.
+ * @brief Set the running thread after the current thread's quantum expired,
+ * with the core's lock held (it is released).
  *
- * @param running_pthread_pararm "PQData" structure of the running thread
+ * @param running_pthread_pararm "pthread_param_t" structure of the running
+ * thread
  */
 void set_fastest_thread_after_quantum(pthread_param_t *running_pthread_pararm)
 {
+	pthread_param_t *ready_pthread_pararm;
+	so_core_t *core = running_pthread_pararm->core;
+
 	// Reset internal timer for the running thread
 	running_pthread_pararm->time_quantum = so_scheduler.time_quantum;
 
-	// Add running thread to the poll of "ready" threads
-	push_node_pq(so_scheduler.ready_threads_pq,
-		     &running_pthread_pararm->pthread_id, sizeof(pthread_t),
-		     running_pthread_pararm->priority);
+	// Add running thread to the poll of "ready" threads of its core
+	push_link_bitmap_pq(core->ready_threads_pq,
+			    &running_pthread_pararm->link,
+			    running_pthread_pararm->priority);
 
-	// Get max priority "ready" thread
-	PQData *max_priority_thread = peak_pq(so_scheduler.ready_threads_pq);
-
-	// Get max priority "ready" thread parameters
-	pthread_param_t *ready_pthread_pararm =
-	    (pthread_param_t *)get_value_hashtable(max_priority_thread->data,
-						   so_scheduler.pthreads_data);
+	// Remove max priority thread from "ready" state
+	ready_pthread_pararm = pop_fastest_thread(core);
 
 	// Mark most important thread as running
-	set_fastest_thread(max_priority_thread);
+	set_fastest_thread(core, ready_pthread_pararm);
 
-	// Remove the thread from "ready" state
-	pop_node_pq(so_scheduler.ready_threads_pq);
+	// Start the new thread and stop the old one
+	switch_thread(core, running_pthread_pararm, ready_pthread_pararm);
+}
 
-	// Signal new thread to start execution
-	if (sem_post(&ready_pthread_pararm->semaphore) == -1) {
-		perror("post");
-		exit(1);
-	}
-	// Signal old thread to stop execution
-	if (sem_wait(&running_pthread_pararm->semaphore) == -1) {
-		perror("wait");
-		exit(1);
-	}
+/**
+ * @brief Gives the "running" state of a core to its most important "ready"
+ * thread if it outranks the running thread, with the core's lock held (it is
+ * released if the threads are switched).
+ *
+ * @param core "so_core_t" structure of the core
+ * @param running_pthread_pararm "pthread_param_t" structure of the running
+ * thread
+ * @return int "1" if the running thread was preempted, "0" otherwise
+ */
+static int preempt_thread(so_core_t *core,
+			  pthread_param_t *running_pthread_pararm)
+{
+	pthread_param_t *ready_pthread_pararm;
+
+	if (is_empty_bitmap_pq(core->ready_threads_pq))
+		return 0;
+
+	// Check if the current thread does not have the biggest priority
+	ready_pthread_pararm = container_of_link(
+	    peak_bitmap_pq(core->ready_threads_pq), pthread_param_t, link);
+	if (ready_pthread_pararm->priority <= running_pthread_pararm->priority)
+		return 0;
+
+	// Remove new thread from "ready" state
+	pop_fastest_thread(core);
+
+	// Set new thread to "running" state
+	set_fastest_thread(core, ready_pthread_pararm);
+
+	// Set the previous thread to "ready" state
+	push_link_bitmap_pq(core->ready_threads_pq,
+			    &running_pthread_pararm->link,
+			    running_pthread_pararm->priority);
+
+	// Start execution for the new thread and stop it for the old thread
+	switch_thread(core, running_pthread_pararm, ready_pthread_pararm);
+
+	return 1;
 }
 
 /**
@@ -181,73 +1414,197 @@ void set_fastest_thread_after_quantum(pthread_param_t *running_pthread_pararm)
  */
 int so_init(unsigned int time_quantum, unsigned int io)
 {
-	if (io > SO_MAX_NUM_EVENTS || time_quantum == 0 ||
-	    so_scheduler.time_quantum != 0)
-		return -1;
+	return so_init_ex(time_quantum, io, NULL);
+}
 
-	// Pass internal parameters
-	so_scheduler.time_quantum = time_quantum;
-	so_scheduler.io = io;
+/**
+ * @brief Keeps the CPUs of a mask that this process may run on.
+ *
+ * @param mask bit "i" selects CPU "i"
+ * @param affinity where the CPU set is stored
+ * @return int number of CPUs in the set
+ */
+static int init_affinity(unsigned long mask, cpu_set_t *affinity)
+{
+	cpu_set_t allowed;
+	unsigned int cpu;
 
-	// Initialize internal data structures
-	so_scheduler.pthreads_data = initialize_hashtable(
-	    HT_CAPACITY, hash_function_ulong, compare_pthreads_attr,
-	    print_pthreads_attr, free_entries_pthreads_attr, 0);
-	so_scheduler.ready_threads_pq =
-	    initialize_list(compare_ulong_pq, print_ulong_pq, free_ulong_pq);
-	so_scheduler.pthreads_created =
-	    initialize_list(compare_ulong, print_ulong, free);
-	so_scheduler.waiting_threads = initialize_list(
-	    compare_io_signal_thread, print_waiting_pthread, free);
-
-	// Dynamic allocation for a deep copy of a thread id
-	so_scheduler.running_thread.data = malloc(sizeof(pthread_t));
+	CPU_ZERO(affinity);
+	if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed)) {
+		perror("sched_getaffinity");
+		exit(1);
+	}
 
-	return 0;
+	for (cpu = 0; cpu < sizeof(mask) * 8; ++cpu)
+		if ((mask >> cpu) & 1 && CPU_ISSET(cpu, &allowed))
+			CPU_SET(cpu, affinity);
+
+	return CPU_COUNT(affinity);
 }
 
 /**
- * @brief Helper function used by a newly created thread. The thread waits to be
- * started, computes its function and lets the next thread take charge after.
+ * @brief Initializes the memory nodes of the cores, each one keeps the CPUs
+ * of its topology node that the threads may run on, or all of them if none
+ * is left. Several nodes pin every thread to the CPUs of its node and place
+ * the task table of each node on its memory.
  *
- * @param data "pthread_param_t" structure will be passed
- * @return void* NULL
+ * @param topology memory nodes of the machine
+ * @param num_nodes number of nodes used, at most one per core
  */
-void *start_thread(void *data)
+static void init_nodes(Topology *topology, unsigned int num_nodes)
 {
-	pthread_param_t *pthread_param = (pthread_param_t *)data;
+	cpu_set_t allowed;
+	so_node_t *node;
+	unsigned int i;
 
-	// Waits until another thread signals that its his turn
-	if (sem_wait(&pthread_param->semaphore) == -1) {
-		perror("wait");
+	if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed)) {
+		perror("sched_getaffinity");
 		exit(1);
 	}
+	if (so_scheduler.pinned)
+		CPU_AND(&allowed, &allowed, &so_scheduler.affinity);
+
+	so_scheduler.nodes =
+	    alloc_arena(SCHEDULER_ARENA, num_nodes * sizeof(so_node_t));
+	so_scheduler.num_nodes = num_nodes;
+	for (i = 0; i < num_nodes; ++i) {
+		node = &so_scheduler.nodes[i];
+		initialize_arena(&node->arena, ARENA_CHUNK_SIZE);
+		if (num_nodes > 1)
+			bind_arena(&node->arena, topology->ids[i]);
+		initialize_task_table(&node->tasks, sizeof(pthread_param_t),
+				      HT_CAPACITY, NODE_ARENA(node));
+
+		CPU_AND(&node->cpus, &topology->cpus[i], &allowed);
+		if (num_nodes == 1 || CPU_COUNT(&node->cpus) == 0)
+			node->cpus = allowed;
+	}
 
-	// Run associated function
-	pthread_param->func(pthread_param->priority);
+	if (num_nodes > 1)
+		so_scheduler.pinned = 1;
+}
+
+/**
+ * @brief Initializes the "so_scheduler" struct like "so_init", the attributes
+ * choose how the tasks are executed.
+ *
+ * @param time_quantum maximum instruction for running state
+ * @param io maximum wait time for a signal
+ * @param attr scheduler attributes, NULL for the defaults
+ * @return int "0" on success, "-1" on error
+ */
+int so_init_ex(unsigned int time_quantum, unsigned int io,
+	       const so_attr_t *attr)
+{
+	unsigned int i, num_cores;
+	unsigned char shared, pinned = 0;
+	long num_cpus;
+	cpu_set_t affinity;
+	Topology topology;
+	const so_backend_t *backend_ops;
+	enum so_backend backend = attr ? attr->backend : SO_BACKEND_KERNEL;
+	enum so_wait_mode wait_mode = attr ? attr->wait_mode : SO_WAIT_BLOCK;
+
+	if (io > SO_MAX_NUM_EVENTS || time_quantum == 0 ||
+	    so_scheduler.time_quantum != 0)
+		return -1;
+
+	// Nothing is stored in "so_scheduler" until every attribute is checked,
+	// so a failed call leaves it free for the next one
+	if (backend == SO_BACKEND_KERNEL && attr && attr->thread_pool)
+		backend_ops = &pool_backend;
+	else if (backend == SO_BACKEND_KERNEL)
+		backend_ops = &kernel_backend;
+	else if (backend == SO_BACKEND_GREEN)
+		backend_ops = &green_backend;
+	else if (backend == SO_BACKEND_EXTERNAL)
+		backend_ops = &external_backend;
+	else
+		return -1;
+
+	if (wait_mode != SO_WAIT_BLOCK && wait_mode != SO_WAIT_ADAPTIVE)
+		return -1;
+
+	// Only kernel threads can run on several cores at once or share the
+	// scheduler with foreign threads
+	num_cores = attr && attr->num_cores ? attr->num_cores : 1;
+	shared = num_cores > 1 || (attr && attr->foreign_threads);
+	if (shared && backend_ops != &kernel_backend &&
+	    backend_ops != &pool_backend)
+		return -1;
 
-	// Gives "running" state to next thread based on priority
-	if (!is_empty_list(so_scheduler.ready_threads_pq)) {
-		PQData *max_priority_thread =
-		    peak_pq(so_scheduler.ready_threads_pq);
-		pthread_param_t *ready_pthread_pararm =
-		    (pthread_param_t *)get_value_hashtable(
-			max_priority_thread->data, so_scheduler.pthreads_data);
+	// Every thread is pinned to the same CPUs, at least one must be usable
+	num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (attr && attr->cpu_mask) {
+		num_cpus = init_affinity(attr->cpu_mask, &affinity);
+		if (num_cpus == 0)
+			return -1;
 
-		// Sets currently running thread
-		set_fastest_thread(max_priority_thread);
+		pinned = 1;
+	}
+
+	// The cores are spread evenly over the memory nodes, a description
+	// may fake them
+	topology.num_nodes = 1;
+	if (attr && attr->numa_topology) {
+		if (parse_topology(&topology, attr->numa_topology))
+			return -1;
+	} else if (num_cores > 1) {
+		read_topology(&topology);
+	}
+	if (topology.num_nodes > num_cores)
+		topology.num_nodes = num_cores;
+
+	so_scheduler.backend = backend_ops;
+	so_scheduler.pinned = pinned;
+	if (pinned)
+		so_scheduler.affinity = affinity;
 
-		// Removes thread from "ready" state
-		pop_node_pq(so_scheduler.ready_threads_pq);
+	// Spinning only pays off if the woken thread runs on another CPU
+	so_scheduler.spin.budget_ns = SPIN_START_NS;
+	if (wait_mode == SO_WAIT_ADAPTIVE && num_cpus > 1)
+		so_scheduler.park_spin = &so_scheduler.spin;
+
+	// Pass internal parameters
+	memset(&so_stats, 0, sizeof(so_stats));
+	initialize_handoff(&so_scheduler.end_handoff);
+	initialize_stack_pool(&so_scheduler.stacks);
+	initialize_inbox(&so_scheduler.inbox);
+	so_scheduler.stack_size = attr ? attr->stack_size : 0;
+	if (so_scheduler.backend == &pool_backend)
+		so_scheduler.thread_stack_size = default_stack_size();
+	so_scheduler.time_quantum = time_quantum;
+	so_scheduler.io = io;
+	so_scheduler.num_cores = num_cores;
+	so_scheduler.shared = shared;
+	if (pthread_mutex_init(&so_scheduler.lock, NULL) ||
+	    pthread_mutex_init(&so_scheduler.tasks_lock, NULL) ||
+	    pthread_mutex_init(&so_scheduler.end_lock, NULL)) {
+		perror("pthread_mutex_init");
+		exit(1);
+	}
 
-		// Set running thread as active
-		if (sem_post(&ready_pthread_pararm->semaphore) == -1) {
-			perror("post");
+	// Initialize internal data structures
+	initialize_arena(&so_scheduler.arena, ARENA_CHUNK_SIZE);
+	init_nodes(&topology, topology.num_nodes);
+	so_scheduler.cores =
+	    alloc_arena(SCHEDULER_ARENA, num_cores * sizeof(so_core_t));
+	for (i = 0; i < num_cores; ++i) {
+		if (pthread_mutex_init(&so_scheduler.cores[i].lock, NULL)) {
+			perror("pthread_mutex_init");
 			exit(1);
 		}
+		so_scheduler.cores[i].ready_threads_pq =
+		    initialize_bitmap_pq(SO_MAX_PRIO, SCHEDULER_ARENA);
+		so_scheduler.cores[i].node =
+		    &so_scheduler.nodes[i * topology.num_nodes / num_cores];
+	}
+	for (i = 0; i < io; ++i) {
+		initialize_link_list(&so_scheduler.waiting_threads[i]);
+		so_scheduler.signals[i].io = i;
 	}
 
-	return NULL;
+	return 0;
 }
 
 /**
@@ -258,51 +1615,49 @@ void *start_thread(void *data)
  * @return tid_t thread id
  */
 tid_t so_fork(so_handler *func, unsigned int priority)
+{
+	return so_fork_ex(func, priority, 0);
+}
+
+/**
+ * @brief Creates a new thread like "so_fork" with its own stack size.
+ *
+ * @param func function attributed to the new thread
+ * @param priority of the new thread
+ * @param stack_size stack size of the new thread, "0" for the scheduler's
+ * @return tid_t thread id
+ */
+tid_t so_fork_ex(so_handler *func, unsigned int priority, size_t stack_size)
 {
 	pthread_param_t *pthread_param;
+	so_core_t *current_core;
+	unsigned char is_running;
+	tid_t tid;
 
 	if (priority > SO_MAX_PRIO || func == NULL)
 		return INVALID_TID;
 
-	// Set thread parameters
-	pthread_param = malloc(sizeof(pthread_param_t));
-	pthread_param->func = func;
-	pthread_param->priority = priority;
-	pthread_param->time_quantum = so_scheduler.time_quantum;
-
-	// Initialize thread semaphore
-	if (sem_init(&pthread_param->semaphore, 0, 0) == -1) {
-		perror("sem_init");
-		exit(1);
-	}
-
-	// Create thread
-	if (pthread_create(&pthread_param->pthread_id, NULL, start_thread,
-			   pthread_param)) {
-		perror("pthread_create");
-		exit(1);
-	}
+	// The thread is created on the memory node of the core expected to
+	// run it, that core is checked again once the thread is queued
+	current_core = choose_core(get_current_core());
+	pthread_param = new_thread(func, priority, stack_size, current_core);
+	tid = pthread_param->pthread_id;
 
-	// Add thread to list of all threads ever created
-	add_last_node_list(so_scheduler.pthreads_created,
-			   &pthread_param->pthread_id, sizeof(pthread_t));
-	// Add thread to "ready" state priority queue
-	push_node_pq(so_scheduler.ready_threads_pq, &pthread_param->pthread_id,
-		     sizeof(pthread_param->pthread_id),
-		     pthread_param->priority);
-	// Map thread id to its properties
-	put_hashtable(&pthread_param->pthread_id,
-		      sizeof(pthread_param->pthread_id), pthread_param,
-		      sizeof(pthread_param), so_scheduler.pthreads_data);
+	// Add thread to "ready" state priority queue of the forking thread's
+	// core, an idle core takes it instead and starts it at once (as the
+	// first ever fork does). A foreign thread has no core to charge, its
+	// threads go to the first core
+	current_core = get_current_core();
+	is_running = !is_foreign_thread() && current_core->isAThreadRunning;
+	queue_thread(pthread_param, current_core);
 
 	// Sets to "running" the most important thread
-	if (so_scheduler.isAThreadRunning) {
+	if (is_running) {
 		// Not first ever fork -> normal procedure (get running thread
-		// data)
-		pthread_param_t *running_pthread_pararm =
-		    (pthread_param_t *)get_value_hashtable(
-			so_scheduler.running_thread.data,
-			so_scheduler.pthreads_data);
+		// data, no lookup needed)
+		pthread_param_t *running_pthread_pararm = get_current_thread();
+
+		lock_core(current_core);
 
 		// Decrease running thread quantum
 		running_pthread_pararm->time_quantum--;
@@ -312,89 +1667,52 @@ tid_t so_fork(so_handler *func, unsigned int priority)
 		if (running_pthread_pararm->time_quantum == 0) {
 			set_fastest_thread_after_quantum(
 			    running_pthread_pararm);
-		} else if (!is_empty_list(so_scheduler.ready_threads_pq)) {
-			PQData *max_priority_thread =
-			    peak_pq(so_scheduler.ready_threads_pq);
-
-			// Check if the current thread does not have the biggest
-			// priority
-			if (max_priority_thread->priority >
-			    so_scheduler.running_thread.priority) {
-				// Get replacer's data
-				pthread_param_t *ready_pthread_pararm =
-				    (pthread_param_t *)get_value_hashtable(
-					max_priority_thread->data,
-					so_scheduler.pthreads_data);
-
-				// Set new thread to "running" state
-				set_fastest_thread(max_priority_thread);
-
-				// Remove new thread from "ready" state
-				pop_node_pq(so_scheduler.ready_threads_pq);
-
-				// Set the previous thread to "ready" state
-				push_node_pq(
-				    so_scheduler.ready_threads_pq,
-				    &running_pthread_pararm->pthread_id,
-				    sizeof(pthread_t),
-				    running_pthread_pararm->priority);
-
-				// Start execution for the new thread
-				if (sem_post(
-					&ready_pthread_pararm->semaphore) ==
-				    -1) {
-					perror("post");
-					exit(1);
-				}
-				// Stop execution for the old thread
-				if (sem_wait(
-					&running_pthread_pararm->semaphore) ==
-				    -1) {
-					perror("wait");
-					exit(1);
-				}
-			}
-		}
-	} else {
-		// Mark the first ever fork as true
-		so_scheduler.isAThreadRunning = 1;
-
-		// Set the new thread directly to "running" state
-		PQData *max_priority_thread =
-		    peak_pq(so_scheduler.ready_threads_pq);
-		set_fastest_thread(max_priority_thread);
-
-		// Remove it from "ready" state
-		pop_node_pq(so_scheduler.ready_threads_pq);
-		// Start execution for the new thread
-		if (sem_post(&pthread_param->semaphore) == -1) {
-			perror("post");
-			exit(1);
+			return tid;
+		} else if (preempt_thread(current_core,
+					  running_pthread_pararm)) {
+			return tid;
 		}
+
+		unlock_core(current_core);
 	}
 
-	return pthread_param->pthread_id;
+	return tid;
 }
 
 /**
  * @brief Wastes thread quantum time and resets the "running" thread if
- * necessary.
+ * necessary. On a shared scheduler the running thread is also preempted by a
+ * more important thread that another core or a foreign thread made "ready".
  *
  */
 void so_exec(void)
 {
-	if (!so_scheduler.isAThreadRunning)
+	pthread_param_t *running_pthread_pararm;
+	so_core_t *core = get_current_core();
+
+	if (is_foreign_thread())
+		return;
+
+	// A thread woken or forked by a foreign thread may preempt this one
+	if (so_scheduler.shared)
+		drain_inbox(core);
+
+	lock_core(core);
+	if (!core->isAThreadRunning) {
+		unlock_core(core);
 		return;
+	}
 
 	// Decrease current thread's quantum
-	pthread_param_t *running_pthread_pararm =
-	    (pthread_param_t *)get_value_hashtable(
-		so_scheduler.running_thread.data, so_scheduler.pthreads_data);
+	running_pthread_pararm = get_current_thread();
 	running_pthread_pararm->time_quantum--;
 
 	// Check if thread's quantum expired
 	if (running_pthread_pararm->time_quantum == 0)
 		set_fastest_thread_after_quantum(running_pthread_pararm);
+	else if (!so_scheduler.shared ||
+		 !preempt_thread(core, running_pthread_pararm))
+		unlock_core(core);
 }
 
 /**
@@ -406,128 +1724,256 @@ void so_exec(void)
  */
 int so_wait(unsigned int io)
 {
-	waiting_pthread_t waiting_pthread;
+	pthread_param_t *running_pthread_pararm, *ready_pthread_pararm;
+	so_core_t *core = get_current_core();
+
+	// Only a scheduled thread can wait for a signal, a foreign thread does
+	// not even read the running state of a core
+	if (is_foreign_thread())
+		return -1;
 
-	if (!so_scheduler.isAThreadRunning)
+	if (!core->isAThreadRunning)
 		return 0;
 
 	if (io >= so_scheduler.io)
 		return -1;
 
 	// Get running thread's data
-	pthread_param_t *running_pthread_pararm =
-	    (pthread_param_t *)get_value_hashtable(
-		so_scheduler.running_thread.data, so_scheduler.pthreads_data);
-
-	// Set "waiting_pthread_t" struct attributes
-	waiting_pthread.pthread_id = running_pthread_pararm->pthread_id;
-	waiting_pthread.priority = running_pthread_pararm->priority;
-	waiting_pthread.io = io;
-
-	// Set thread state to "waiting"
-	add_last_node_list(so_scheduler.waiting_threads, &waiting_pthread,
-			   sizeof(waiting_pthread_t));
-
-	// Check if there are "ready" threads
-	if (!is_empty_list(so_scheduler.ready_threads_pq)) {
-		// Get best thread available
-		PQData *max_priority_thread =
-		    peak_pq(so_scheduler.ready_threads_pq);
-		pthread_param_t *ready_pthread_pararm =
-		    (pthread_param_t *)get_value_hashtable(
-			max_priority_thread->data, so_scheduler.pthreads_data);
-
-		// Mark new thread as "running"
-		set_fastest_thread(max_priority_thread);
-
-		// Remove new thread from "ready" state
-		pop_node_pq(so_scheduler.ready_threads_pq);
-
-		// Signal new thread to start execution
-		if (sem_post(&ready_pthread_pararm->semaphore) == -1) {
-			perror("post");
-			exit(1);
-		}
-	}
+	running_pthread_pararm = get_current_thread();
 
-	// Signal old thread to stop execution
-	if (sem_wait(&running_pthread_pararm->semaphore) == -1) {
-		perror("wait");
-		exit(1);
-	}
+	if (so_scheduler.shared)
+		drain_inbox(core);
+
+	// Set thread state to "waiting" on the "io" device queue, a signal
+	// may queue it again before it left its core
+	lock_scheduler();
+	running_pthread_pararm->io = io;
+	add_last_link_list(&so_scheduler.waiting_threads[io],
+			   &running_pthread_pararm->link);
+	so_scheduler.num_waiting++;
+	unlock_scheduler();
+
+	// Check if there are "ready" threads on the core (or on another core)
+	// and mark the best thread available as "running"
+	lock_core(core);
+	ready_pthread_pararm = leave_core(core);
+
+	// Signal new thread to start execution and old thread to stop
+	switch_thread(core, running_pthread_pararm, ready_pthread_pararm);
 
 	return 0;
 }
 
 /**
  * @brief Marks the waiting threads waiting for the io signal as "ready" from
- * "waiting", also resets the "running" thread.
+ * "waiting", also resets the "running" thread. A foreign thread only wakes
+ * the threads, they preempt at the next scheduling point of their core.
  *
  * @param io signal to be used to unlock threads
  * @return int number of threads woken or "-1" on error
  */
 int so_signal(unsigned int io)
 {
-	int num_threads = 0;
+	int num_threads;
+	so_core_t *core = get_current_core();
+	pthread_param_t *running_pthread_pararm, *ready_pthread_pararm;
+	pthread_param_t *waiting_pthread_pararm;
+	LinkList woken, woken_here;
+	ListLink *link;
 
 	if (io >= so_scheduler.io)
 		return -1;
 
-	if (!so_scheduler.isAThreadRunning ||
-	    is_empty_list(so_scheduler.waiting_threads))
+	if (is_foreign_thread())
+		return wake_waiting_threads(io);
+
+	if (!core->isAThreadRunning)
 		return 0;
 
-	// Get "running" thread data
-	pthread_param_t *running_pthread_pararm =
-	    (pthread_param_t *)get_value_hashtable(
-		so_scheduler.running_thread.data, so_scheduler.pthreads_data);
+	// A signal reschedules as soon as any thread waits, on any device
+	lock_scheduler();
+	if (so_scheduler.num_waiting == 0) {
+		unlock_scheduler();
+		return 0;
+	}
+	num_threads = take_waiting_threads(io, &woken);
+	unlock_scheduler();
+
+	// Signal all threads waiting on the "io" device to be set to "ready",
+	// a thread goes back to its last core, or to an idle core that starts
+	// it at once. The ones that stay on this core are queued after the
+	// running thread
+	initialize_link_list(&woken_here);
+	while ((link = pop_first_link_list(&woken)) != NULL) {
+		waiting_pthread_pararm =
+		    container_of_link(link, pthread_param_t, link);
+		if (choose_core(waiting_pthread_pararm->core) == core)
+			add_last_link_list(&woken_here, link);
+		else
+			queue_thread(waiting_pthread_pararm,
+				     waiting_pthread_pararm->core);
+	}
 
 	// Mark "running" thread as "ready"
-	push_node_pq(so_scheduler.ready_threads_pq,
-		     &running_pthread_pararm->pthread_id, sizeof(pthread_t),
-		     running_pthread_pararm->priority);
+	running_pthread_pararm = get_current_thread();
+	lock_core(core);
+	push_link_bitmap_pq(core->ready_threads_pq,
+			    &running_pthread_pararm->link,
+			    running_pthread_pararm->priority);
+	while ((link = pop_first_link_list(&woken_here)) != NULL) {
+		waiting_pthread_pararm =
+		    container_of_link(link, pthread_param_t, link);
+		push_link_bitmap_pq(core->ready_threads_pq, link,
+				    waiting_pthread_pararm->priority);
+	}
+
+	// Remove the most important thread from "ready" state
+	ready_pthread_pararm = pop_fastest_thread(core);
+
+	// Mark new thread as "running"
+	set_fastest_thread(core, ready_pthread_pararm);
+
+	// Signal new thread to start execution and old thread to stop
+	switch_thread(core, running_pthread_pararm, ready_pthread_pararm);
 
-	// Signal all threads that have the "io" signal to be set to "ready"
-	Node *thread_data = pop_node_list(so_scheduler.waiting_threads, &io);
+	return num_threads;
+}
 
-	while (thread_data != NULL) {
-		push_node_pq(
-		    so_scheduler.ready_threads_pq,
-		    &((waiting_pthread_t *)thread_data->data)->pthread_id,
-		    sizeof(pthread_t),
-		    ((waiting_pthread_t *)thread_data->data)->priority);
+/**
+ * @brief Leaves a request in the inbox without any lock, the first busy core
+ * to reach a scheduling point runs it. If a core is idle nobody may reach
+ * one, so the caller runs the requests itself.
+ *
+ * @param request "so_request_t" structure of the request
+ */
+static void post_request(so_request_t *request)
+{
+	unsigned int i;
 
-		free(thread_data->data);
-		free(thread_data);
+	push_inbox(&so_scheduler.inbox, &request->link);
 
-		thread_data = pop_node_list(so_scheduler.waiting_threads, &io);
-		num_threads++;
+	// Pairs with the fence of a core going idle in "fill_core"
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	for (i = 0; i < so_scheduler.num_cores; ++i) {
+		if (is_idle_core(&so_scheduler.cores[i])) {
+			drain_inbox(so_scheduler.cores);
+			return;
+		}
 	}
+}
+
+/**
+ * @brief Signals an io device like "so_signal" from a foreign thread, the
+ * waiting threads are woken at the next scheduling point.
+ *
+ * @param io signal to be used to unlock threads
+ * @return int "0" on success, "-1" on error
+ */
+int so_signal_async(unsigned int io)
+{
+	so_request_t *request;
 
-	// Get most important thread data
-	PQData *max_priority_thread = peak_pq(so_scheduler.ready_threads_pq);
-	pthread_param_t *ready_pthread_pararm =
-	    (pthread_param_t *)get_value_hashtable(max_priority_thread->data,
-						   so_scheduler.pthreads_data);
+	if (!so_scheduler.shared || io >= so_scheduler.io)
+		return -1;
 
-	// Mark new thread as "running"
-	set_fastest_thread(max_priority_thread);
+	// Every signal of a device still in the inbox wakes the same threads,
+	// so each device has one request, posted only if it is not there yet
+	request = &so_scheduler.signals[io];
+	if (!__atomic_exchange_n(&request->posted, 1, __ATOMIC_ACQ_REL))
+		post_request(request);
 
-	// Remove the new thread from "ready" state
-	pop_node_pq(so_scheduler.ready_threads_pq);
+	return 0;
+}
 
-	// Signal new thread to start execution
-	if (sem_post(&ready_pthread_pararm->semaphore) == -1) {
-		perror("post");
-		exit(1);
-	}
-	// Signal old thread to stop execution
-	if (sem_wait(&running_pthread_pararm->semaphore) == -1) {
-		perror("wait");
-		exit(1);
-	}
+/**
+ * @brief Creates a new thread like "so_fork" from a foreign thread, it is
+ * created at the next scheduling point.
+ *
+ * @param func function attributed to the new thread
+ * @param priority of the new thread
+ * @return int "0" on success, "-1" on error
+ */
+int so_fork_async(so_handler *func, unsigned int priority)
+{
+	so_request_t *request;
 
-	return num_threads;
+	if (!so_scheduler.shared || priority > SO_MAX_PRIO || func == NULL)
+		return -1;
+
+	request = calloc(1, sizeof(so_request_t));
+	if (!request)
+		exit(12);
+
+	request->func = func;
+	request->priority = priority;
+	post_request(request);
+
+	return 0;
+}
+
+/**
+ * @brief Gets the thread that holds the "running" state.
+ *
+ * @return tid_t id of the running thread or INVALID_TID if none is running
+ */
+tid_t so_running(void)
+{
+	so_core_t *core = get_current_core();
+
+	if (!core->isAThreadRunning)
+		return INVALID_TID;
+
+	return core->running_thread->pthread_id;
+}
+
+/**
+ * @brief Ends the running task of the external backend, its handler returned.
+ *
+ */
+void so_exit(void)
+{
+	if (so_scheduler.backend != &external_backend ||
+	    !so_scheduler.cores->isAThreadRunning)
+		return;
+
+	finish_thread(so_scheduler.cores->running_thread);
+}
+
+/**
+ * @brief Adds the counters of a core to a total.
+ *
+ * @param total where the counters are added
+ * @param stats counters of a core
+ */
+static void add_stats(so_stats_t *total, const so_stats_t *stats)
+{
+	total->switches += stats->switches;
+	total->skipped_switches += stats->skipped_switches;
+	total->steals += stats->steals;
+	total->remote_steals += stats->remote_steals;
+}
+
+/**
+ * @brief Gets the counters of the current (or last ended) scheduler, the
+ * counters of each core are read under its lock.
+ *
+ * @param stats where the counters are copied
+ */
+void so_get_stats(so_stats_t *stats)
+{
+	unsigned int i;
+	so_core_t *core;
+
+	if (stats == NULL)
+		return;
+
+	*stats = so_stats;
+	for (i = 0; i < so_scheduler.num_cores; ++i) {
+		core = &so_scheduler.cores[i];
+		lock_core(core);
+		add_stats(stats, &core->stats);
+		unlock_core(core);
+	}
 }
 
 /**
@@ -536,28 +1982,41 @@ int so_signal(unsigned int io)
  */
 void so_end(void)
 {
-	Node *curr;
-
-	// Waits for all ever created threads to finish
-	if (so_scheduler.pthreads_created != NULL) {
-		curr = so_scheduler.pthreads_created->head;
-		while (curr != NULL) {
-			pthread_t thread =
-			    *(pthread_t *)curr->data;
-			if (pthread_join(thread, NULL)) {
-				perror("pthread_join");
-				exit(1);
-			}
-			curr = curr->next;
-		}
+	unsigned int i;
+	ListLink *link, *next_link;
+	so_request_t *request;
+
+	// Waits once for all ever created threads to finish
+	if (so_scheduler.backend != NULL) {
+		so_scheduler.backend->end();
+		destroy_handoff(&so_scheduler.end_handoff);
+		pthread_mutex_destroy(&so_scheduler.lock);
+		pthread_mutex_destroy(&so_scheduler.tasks_lock);
+		pthread_mutex_destroy(&so_scheduler.end_lock);
 	}
 
-	// Free all internal structures
-	free_list(&so_scheduler.pthreads_created);
-	free_list(&so_scheduler.ready_threads_pq);
-	free_list(&so_scheduler.waiting_threads);
-	free_hashtable(&so_scheduler.pthreads_data);
-	free(so_scheduler.running_thread.data);
+	// Forks posted after the last task ended are dropped
+	for (link = take_inbox(&so_scheduler.inbox); link; link = next_link) {
+		next_link = link->next;
+		request = container_of_link(link, so_request_t, link);
+		if (request->func != NULL)
+			free(request);
+	}
+
+	// Free all internal structures, with an arena they are released in one
+	// step together with the arena. The counters of the cores are kept
+	for (i = 0; i < so_scheduler.num_cores; ++i) {
+		add_stats(&so_stats, &so_scheduler.cores[i].stats);
+		pthread_mutex_destroy(&so_scheduler.cores[i].lock);
+		free_bitmap_pq(&so_scheduler.cores[i].ready_threads_pq);
+	}
+	release_arena(SCHEDULER_ARENA, so_scheduler.cores);
+	for (i = 0; i < so_scheduler.num_nodes; ++i) {
+		free_task_table(&so_scheduler.nodes[i].tasks);
+		free_arena(&so_scheduler.nodes[i].arena);
+	}
+	release_arena(SCHEDULER_ARENA, so_scheduler.nodes);
+	free_arena(&so_scheduler.arena);
 
 	// Sets all the struct's field to "0" for safety
 	memset(&so_scheduler, 0, sizeof(so_scheduler_t));
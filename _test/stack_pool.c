@@ -0,0 +1,136 @@
+#include "stack_pool.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MAP_STACK
+#define MAP_STACK 0
+#endif
+
+/**
+ * @brief Returns the class of a stack size, every class holds one size.
+ *
+ * @param size rounded stack size
+ * @return unsigned int index of the free list
+ */
+static unsigned int class_stack_pool(size_t size)
+{
+	unsigned int index = 0;
+
+	while (size >>= 1)
+		index++;
+
+	return index;
+}
+
+/**
+ * @brief Initializes a pool of stacks. The stacks are mapped with a guard
+ * page below them and only the pages a task touches take memory, a released
+ * stack is kept mapped and handed out again for the same size.
+ *
+ * @param pool to be initialized
+ */
+void initialize_stack_pool(StackPool *pool)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	memset(pool, 0, sizeof(StackPool));
+	pool->page_size = page_size > 0 ? (size_t)page_size : 4096;
+}
+
+/**
+ * @brief Rounds a stack size up to the size the pool hands out, a power of
+ * two of at least MIN_POOL_STACK_SIZE.
+ *
+ * @param size requested stack size
+ * @return size_t usable size of the stack
+ */
+size_t size_stack_pool(size_t size)
+{
+	size_t rounded = MIN_POOL_STACK_SIZE;
+
+	while (rounded < size)
+		rounded *= 2;
+
+	return rounded;
+}
+
+/**
+ * @brief Takes a stack from the pool, a new one is mapped if no stack of that
+ * size was released.
+ *
+ * @param pool instance of the pool
+ * @param size usable size, as returned by "size_stack_pool"
+ * @return void* lowest usable address of the stack
+ */
+void *alloc_stack_pool(StackPool *pool, size_t size)
+{
+	char *base;
+	void *stack;
+	unsigned int index = class_stack_pool(size);
+
+	if (pool->free_stacks[index] != NULL) {
+		stack = pool->free_stacks[index];
+		pool->free_stacks[index] = *(void **)stack;
+
+		return stack;
+	}
+
+	base = mmap(NULL, pool->page_size + size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+		    -1, 0);
+	if (base == MAP_FAILED)
+		exit(12);
+
+	// An overflow faults on the guard page instead of corrupting memory
+	if (mprotect(base, pool->page_size, PROT_NONE) == -1) {
+		perror("mprotect");
+		exit(1);
+	}
+
+	return base + pool->page_size;
+}
+
+/**
+ * @brief Gives a stack back to the pool, it must not be in use anymore.
+ *
+ * @param pool instance of the pool
+ * @param stack previously returned by "alloc_stack_pool"
+ * @param size usable size of the stack
+ */
+void release_stack_pool(StackPool *pool, void *stack, size_t size)
+{
+	unsigned int index = class_stack_pool(size);
+
+	if (stack == NULL)
+		return;
+
+	*(void **)stack = pool->free_stacks[index];
+	pool->free_stacks[index] = stack;
+}
+
+/**
+ * @brief Unmaps every stack released to the pool.
+ *
+ * @param pool instance of the pool
+ */
+void free_stack_pool(StackPool *pool)
+{
+	unsigned int i;
+	void *stack, *next;
+
+	for (i = 0; i < STACK_POOL_CLASSES; ++i) {
+		stack = pool->free_stacks[i];
+		while (stack != NULL) {
+			next = *(void **)stack;
+			if (munmap((char *)stack - pool->page_size,
+				   pool->page_size + ((size_t)1 << i)) == -1) {
+				perror("munmap");
+				exit(1);
+			}
+			stack = next;
+		}
+		pool->free_stacks[i] = NULL;
+	}
+}
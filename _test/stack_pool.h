@@ -0,0 +1,24 @@
+#ifndef STACK_POOL_H
+#define STACK_POOL_H
+
+#include <stdlib.h>
+
+#define MIN_POOL_STACK_SIZE (16 * 1024)
+#define STACK_POOL_CLASSES (sizeof(size_t) * 8)
+
+typedef struct StackPool {
+	void *free_stacks[STACK_POOL_CLASSES];
+	size_t page_size;
+} StackPool;
+
+void initialize_stack_pool(StackPool *pool);
+
+size_t size_stack_pool(size_t size);
+
+void *alloc_stack_pool(StackPool *pool, size_t size);
+
+void release_stack_pool(StackPool *pool, void *stack, size_t size);
+
+void free_stack_pool(StackPool *pool);
+
+#endif
@@ -0,0 +1,1071 @@
+/*
+ * Threads scheduler backend tests
+ *
+ * 2022, Operating Systems
+ */
+
+#define _GNU_SOURCE
+
+#include "scheduler_test.h"
+#include "so_scheduler_ex.h"
+#include "topology.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SO_DEV0		0
+
+static unsigned int test_exec_status = SO_TEST_FAIL;
+static unsigned int test_exec_step;
+static tid_t test_main_tid;
+
+/* checks that the steps of the tasks run in order */
+#define SO_TEST_STEP(expect_step) \
+	do { \
+		if (test_exec_step != (expect_step)) \
+			so_fail("invalid tasks order"); \
+		test_exec_step++; \
+	} while (0)
+
+/*
+ * 28) Test green tasks
+ *
+ * tests if the green backend runs every task on the thread of the first
+ * fork, by priority, and returns from that fork once no task is left
+ */
+static void test_sched_handler_28_2(unsigned int dummy)
+{
+	if (!this_tid(test_main_tid))
+		so_fail("green task on another thread");
+
+	SO_TEST_STEP(1);
+	if (so_wait(SO_DEV0) != 0)
+		so_fail("cannot wait");
+	SO_TEST_STEP(3);
+}
+
+static void test_sched_handler_28_1(unsigned int dummy)
+{
+	tid_t tid;
+
+	if (!this_tid(test_main_tid))
+		so_fail("green task on another thread");
+
+	SO_TEST_STEP(0);
+	tid = so_fork(test_sched_handler_28_2, 2);
+	if (equal_tids(tid, INVALID_TID) || equal_tids(tid, so_running()))
+		so_fail("invalid task id");
+
+	SO_TEST_STEP(2);
+	if (so_signal(SO_DEV0) != 1)
+		so_fail("invalid number of woken tasks");
+	SO_TEST_STEP(4);
+
+	test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_28(void)
+{
+	so_attr_t attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.backend = SO_BACKEND_GREEN;
+	test_exec_status = SO_TEST_FAIL;
+	test_exec_step = 0;
+	test_main_tid = get_tid();
+
+	if (so_init_ex(SO_MAX_UNITS, 1, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_28_1, 1), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+	/* every task already ran */
+	if (test_exec_step != 5)
+		test_exec_status = SO_TEST_FAIL;
+
+test:
+	so_end();
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 29) Test extended init params
+ *
+ * tests if the attributes of the extended init are properly checked
+ */
+void test_sched_29(void)
+{
+	so_attr_t attr;
+	int ret = 0;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.backend = SO_BACKEND_EXTERNAL + 1;
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) == 0) {
+		so_error("invalid backend");
+		ret = -1;
+		goto test;
+	}
+
+	attr.backend = SO_BACKEND_GREEN;
+	if (so_init_ex(0, 0, &attr) == 0) {
+		so_error("invalid time quantum");
+		ret = -1;
+		goto test;
+	}
+
+	if (so_init_ex(SO_MAX_UNITS, SO_MAX_NUM_EVENTS + 1, &attr) == 0) {
+		so_error("invalid I/O devices");
+		ret = -1;
+		goto test;
+	}
+
+	/* no attributes select the defaults */
+	if (so_init_ex(SO_MAX_UNITS, 0, NULL) < 0) {
+		so_error("initialization failed");
+		ret = -1;
+		goto test;
+	}
+
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) == 0) {
+		so_error("scheduler initialized two times");
+		ret = -1;
+	}
+
+test:
+	so_end();
+
+	basic_test(ret == 0);
+}
+
+/*
+ * 30) Test adaptive wait
+ *
+ * tests if the tasks keep the round robin order when they spin before
+ * sleeping
+ */
+static void test_sched_handler_30_2(unsigned int dummy)
+{
+	SO_TEST_STEP(1);
+	so_exec();
+	SO_TEST_STEP(3);
+}
+
+static void test_sched_handler_30_1(unsigned int dummy)
+{
+	SO_TEST_STEP(0);
+	if (equal_tids(so_fork(test_sched_handler_30_2, 0), INVALID_TID))
+		so_fail("cannot create new task");
+	SO_TEST_STEP(2);
+	so_exec();
+	SO_TEST_STEP(4);
+
+	test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_30(void)
+{
+	so_attr_t attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.wait_mode = SO_WAIT_ADAPTIVE + 1;
+	test_exec_status = SO_TEST_FAIL;
+	test_exec_step = 0;
+
+	if (so_init_ex(1, 0, &attr) == 0) {
+		so_error("invalid wait mode");
+		goto test;
+	}
+
+	attr.wait_mode = SO_WAIT_ADAPTIVE;
+	if (so_init_ex(1, 0, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_30_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+test:
+	so_end();
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 31) Test scheduler stats
+ *
+ * tests if a reschedule that keeps the running task is counted as skipped,
+ * a handoff as a switch, and if the counters are kept after "so_end"
+ */
+static so_stats_t test_stats;
+
+static void test_sched_handler_31_2(unsigned int dummy)
+{
+	so_stats_t stats;
+
+	so_get_stats(&stats);
+	if (stats.switches != test_stats.switches + 1)
+		so_fail("handoff not counted");
+}
+
+static void test_sched_handler_31_1(unsigned int dummy)
+{
+	so_stats_t stats;
+
+	so_get_stats(&test_stats);
+
+	/* no other task is ready, the quantum expires and nothing changes */
+	so_exec();
+	so_exec();
+	so_exec();
+
+	so_get_stats(&stats);
+	if (stats.switches != test_stats.switches ||
+	    stats.skipped_switches != test_stats.skipped_switches + 3) {
+		so_error("kept task not counted as skipped");
+		return;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_31_2, 0), INVALID_TID))
+		so_fail("cannot create new task");
+
+	test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_31(void)
+{
+	so_stats_t stats;
+
+	test_exec_status = SO_TEST_FAIL;
+
+	if (so_init(1, 0) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	so_get_stats(&stats);
+	if (stats.switches != 0 || stats.skipped_switches != 0) {
+		so_error("counters not reset");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_31_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+test:
+	so_end();
+
+	so_get_stats(&stats);
+	if (stats.switches == 0 || stats.skipped_switches < 3)
+		test_exec_status = SO_TEST_FAIL;
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 32) Test thread pool
+ *
+ * tests if a task forked after another one ended runs on its thread, so it
+ * gets its tid, and if "so_end" waits for every pooled task
+ */
+static tid_t test_pool_tid;
+static unsigned int test_pool_ended;
+
+static void test_sched_handler_32_3(unsigned int dummy)
+{
+	so_exec();
+	so_exec();
+	test_pool_ended++;
+}
+
+static void test_sched_handler_32_2(unsigned int dummy)
+{
+	test_pool_tid = get_tid();
+	test_pool_ended++;
+}
+
+static void test_sched_handler_32_1(unsigned int dummy)
+{
+	tid_t tid;
+
+	/* the new task preempts this one and ends at once */
+	tid = so_fork(test_sched_handler_32_2, 1);
+	if (!equal_tids(tid, test_pool_tid))
+		so_fail("invalid task id");
+
+	tid = so_fork(test_sched_handler_32_3, 0);
+	if (!equal_tids(tid, test_pool_tid)) {
+		so_error("thread not reused");
+		return;
+	}
+
+	test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_32(void)
+{
+	so_attr_t attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.thread_pool = 1;
+	test_exec_status = SO_TEST_FAIL;
+	test_pool_ended = 0;
+
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_32_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+test:
+	so_end();
+
+	if (test_pool_ended != 2)
+		test_exec_status = SO_TEST_FAIL;
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 33) Test task stack size
+ *
+ * tests if a task gets at least the stack it asked for, even when an idle
+ * pooled thread with a default stack is left
+ */
+#define SO_BIG_STACK	(64 << 20)
+
+static size_t test_stack_size(void)
+{
+	pthread_attr_t attr;
+	size_t stack_size = 0;
+
+	if (pthread_getattr_np(pthread_self(), &attr))
+		return 0;
+	pthread_attr_getstacksize(&attr, &stack_size);
+	pthread_attr_destroy(&attr);
+
+	return stack_size;
+}
+
+static void test_sched_handler_33_3(unsigned int dummy)
+{
+	if (test_stack_size() < SO_BIG_STACK)
+		so_fail("stack too small");
+	test_exec_step++;
+}
+
+static void test_sched_handler_33_2(unsigned int dummy)
+{
+	test_exec_step++;
+}
+
+static void test_sched_handler_33_1(unsigned int dummy)
+{
+	/* leaves an idle thread with a default stack */
+	if (equal_tids(so_fork(test_sched_handler_33_2, 1), INVALID_TID))
+		so_fail("cannot create new task");
+
+	if (equal_tids(so_fork_ex(test_sched_handler_33_3, 1, SO_BIG_STACK),
+		       INVALID_TID))
+		so_fail("cannot create new task");
+
+	if (test_exec_step == 2)
+		test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_33(void)
+{
+	so_attr_t attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.thread_pool = 1;
+	test_exec_status = SO_TEST_FAIL;
+	test_exec_step = 0;
+
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_33_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+test:
+	so_end();
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 34) Test CPU mask
+ *
+ * tests if every task is pinned to the CPUs of the mask
+ */
+static cpu_set_t test_cpus;
+
+static int test_pinned(const cpu_set_t *cpus)
+{
+	cpu_set_t affinity;
+
+	if (sched_getaffinity(0, sizeof(affinity), &affinity))
+		return 0;
+
+	return CPU_EQUAL(&affinity, cpus);
+}
+
+static void test_sched_handler_34_2(unsigned int dummy)
+{
+	if (!test_pinned(&test_cpus))
+		so_fail("task not pinned");
+	test_exec_step++;
+}
+
+static void test_sched_handler_34_1(unsigned int dummy)
+{
+	if (!test_pinned(&test_cpus))
+		so_fail("task not pinned");
+
+	if (equal_tids(so_fork(test_sched_handler_34_2, 1), INVALID_TID))
+		so_fail("cannot create new task");
+
+	if (test_exec_step == 1)
+		test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_34(void)
+{
+	so_attr_t attr;
+	unsigned int cpu;
+
+	memset(&attr, 0, sizeof(attr));
+	test_exec_status = SO_TEST_FAIL;
+	test_exec_step = 0;
+
+	/* the first CPU the test may run on */
+	if (sched_getaffinity(0, sizeof(test_cpus), &test_cpus)) {
+		so_error("cannot get the CPUs");
+		goto test;
+	}
+	for (cpu = 0; !CPU_ISSET(cpu, &test_cpus); cpu++)
+		;
+	CPU_ZERO(&test_cpus);
+	CPU_SET(cpu, &test_cpus);
+	attr.cpu_mask = 1UL << cpu;
+
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_34_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+test:
+	so_end();
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 35) Test failed extended init
+ *
+ * tests if a failed extended init leaves nothing behind: the scheduler
+ * ends cleanly and the next one uses kernel threads, not pinned
+ */
+static void test_sched_handler_35(unsigned int dummy)
+{
+	if (this_tid(test_main_tid))
+		so_fail("task on the main thread");
+	if (!test_pinned(&test_cpus))
+		so_fail("task pinned");
+
+	test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_35(void)
+{
+	so_attr_t attr;
+
+	memset(&attr, 0, sizeof(attr));
+	test_exec_status = SO_TEST_FAIL;
+	test_main_tid = get_tid();
+
+	if (sched_getaffinity(0, sizeof(test_cpus), &test_cpus)) {
+		so_error("cannot get the CPUs");
+		goto test;
+	}
+
+	/* green tasks cannot be shared with foreign threads */
+	attr.backend = SO_BACKEND_GREEN;
+	attr.foreign_threads = 1;
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) == 0) {
+		so_error("shared green tasks");
+		goto test;
+	}
+	so_end();
+
+	/* the CPU mask is valid, the wait mode is not */
+	attr.foreign_threads = 0;
+	attr.cpu_mask = 1;
+	attr.wait_mode = SO_WAIT_ADAPTIVE + 1;
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) == 0) {
+		so_error("invalid wait mode");
+		goto test;
+	}
+
+	if (so_init(SO_MAX_UNITS, 0) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_35, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+test:
+	so_end();
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 36) Test external tasks
+ *
+ * tests if the scheduling calls only choose the running task, which the
+ * caller runs and ends with "so_exit"
+ */
+static void test_sched_handler_36(unsigned int dummy)
+{
+	so_fail("external task handler called");
+}
+
+void test_sched_36(void)
+{
+	so_attr_t attr;
+	tid_t tid_1, tid_2;
+	int ret = -1;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.backend = SO_BACKEND_EXTERNAL;
+
+	if (so_init_ex(1, 1, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	tid_1 = so_fork(test_sched_handler_36, 0);
+	if (equal_tids(tid_1, INVALID_TID) ||
+	    !equal_tids(so_running(), tid_1)) {
+		so_error("first task not running");
+		goto test;
+	}
+
+	/* nothing else is ready, the first task keeps running */
+	so_exec();
+	if (!equal_tids(so_running(), tid_1)) {
+		so_error("first task preempted");
+		goto test;
+	}
+
+	tid_2 = so_fork(test_sched_handler_36, 1);
+	if (equal_tids(tid_2, tid_1) || !equal_tids(so_running(), tid_2)) {
+		so_error("new task not running");
+		goto test;
+	}
+
+	if (so_wait(SO_DEV0) != 0 || !equal_tids(so_running(), tid_1)) {
+		so_error("waiting task running");
+		goto test;
+	}
+
+	if (so_signal(SO_DEV0) != 1 || !equal_tids(so_running(), tid_2)) {
+		so_error("woken task not running");
+		goto test;
+	}
+
+	so_exit();
+	if (!equal_tids(so_running(), tid_1)) {
+		so_error("first task not resumed");
+		goto test;
+	}
+
+	so_exit();
+	if (!equal_tids(so_running(), INVALID_TID)) {
+		so_error("ended task running");
+		goto test;
+	}
+
+	ret = 0;
+
+test:
+	so_end();
+
+	basic_test(ret == 0);
+}
+
+/*
+ * 38) Test end of tasks
+ *
+ * tests if "so_end" waits for every task still left, with and without the
+ * thread pool
+ */
+#define SO_END_TASKS	50
+
+static unsigned int test_end_tasks;
+
+static void test_sched_handler_38_2(unsigned int dummy)
+{
+	so_exec();
+	so_exec();
+	test_end_tasks++;
+}
+
+static void test_sched_handler_38_1(unsigned int dummy)
+{
+	unsigned int i;
+
+	for (i = 0; i < SO_END_TASKS; i++)
+		if (equal_tids(so_fork(test_sched_handler_38_2, 0),
+			       INVALID_TID))
+			so_fail("cannot create new task");
+}
+
+void test_sched_38(void)
+{
+	so_attr_t attr;
+	int ret = 0;
+
+	memset(&attr, 0, sizeof(attr));
+
+	for (attr.thread_pool = 0; attr.thread_pool < 2; attr.thread_pool++) {
+		test_end_tasks = 0;
+
+		if (so_init_ex(SO_MAX_UNITS, 0, &attr) < 0) {
+			so_error("initialization failed");
+			ret = -1;
+			break;
+		}
+
+		if (equal_tids(so_fork(test_sched_handler_38_1, 0),
+			       INVALID_TID)) {
+			so_error("cannot create new task");
+			ret = -1;
+		}
+
+		so_end();
+
+		if (test_end_tasks != SO_END_TASKS) {
+			so_error("task left after the end");
+			ret = -1;
+		}
+	}
+
+	basic_test(ret == 0);
+}
+
+/*
+ * 39) Test several cores
+ *
+ * tests if two tasks run at once on two cores: each one waits for the
+ * other one without any scheduler call
+ */
+static unsigned int test_core_flags[2];
+
+static int test_wait_flag(unsigned int *flag)
+{
+	time_t deadline = time(NULL) + 5;
+
+	while (!__atomic_load_n(flag, __ATOMIC_ACQUIRE)) {
+		if (time(NULL) > deadline)
+			return -1;
+		sched_yield();
+	}
+
+	return 0;
+}
+
+static void test_sched_handler_39_2(unsigned int dummy)
+{
+	__atomic_store_n(&test_core_flags[1], 1, __ATOMIC_RELEASE);
+	if (test_wait_flag(&test_core_flags[0]))
+		so_fail("tasks not running at once");
+}
+
+static void test_sched_handler_39_1(unsigned int dummy)
+{
+	if (equal_tids(so_fork(test_sched_handler_39_2, 0), INVALID_TID))
+		so_fail("cannot create new task");
+
+	__atomic_store_n(&test_core_flags[0], 1, __ATOMIC_RELEASE);
+	if (test_wait_flag(&test_core_flags[1]))
+		so_fail("tasks not running at once");
+
+	test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_39(void)
+{
+	so_attr_t attr;
+
+	memset(&attr, 0, sizeof(attr));
+	memset(test_core_flags, 0, sizeof(test_core_flags));
+	attr.backend = SO_BACKEND_GREEN;
+	attr.num_cores = 2;
+	test_exec_status = SO_TEST_FAIL;
+
+	/* only kernel threads run on several cores */
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) == 0) {
+		so_error("green tasks on several cores");
+		goto test;
+	}
+
+	attr.backend = SO_BACKEND_KERNEL;
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_39_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+test:
+	so_end();
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 40) Test stealing
+ *
+ * tests if a core left without "ready" tasks takes one from the other core
+ */
+static void test_sched_handler_40_3(unsigned int dummy)
+{
+	__atomic_store_n(&test_core_flags[1], 1, __ATOMIC_RELEASE);
+}
+
+static void test_sched_handler_40_2(unsigned int dummy)
+{
+	/* ends once the other core has "ready" tasks */
+	if (test_wait_flag(&test_core_flags[0]))
+		so_fail("tasks not running at once");
+}
+
+static void test_sched_handler_40_1(unsigned int dummy)
+{
+	if (equal_tids(so_fork(test_sched_handler_40_2, 0), INVALID_TID) ||
+	    equal_tids(so_fork(test_sched_handler_40_3, 0), INVALID_TID) ||
+	    equal_tids(so_fork(test_sched_handler_40_3, 0), INVALID_TID))
+		so_fail("cannot create new task");
+
+	/* only a task taken by the other core can set the flag */
+	__atomic_store_n(&test_core_flags[0], 1, __ATOMIC_RELEASE);
+	if (test_wait_flag(&test_core_flags[1]))
+		so_fail("no task stolen");
+
+	test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_40(void)
+{
+	so_attr_t attr;
+	so_stats_t stats;
+
+	memset(&attr, 0, sizeof(attr));
+	memset(test_core_flags, 0, sizeof(test_core_flags));
+	attr.num_cores = 2;
+	test_exec_status = SO_TEST_FAIL;
+
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_40_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+test:
+	so_end();
+
+	so_get_stats(&stats);
+	if (stats.steals == 0)
+		test_exec_status = SO_TEST_FAIL;
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 41) Test foreign threads
+ *
+ * tests if a thread that is not a task may fork and signal at any time,
+ * but not wait
+ */
+static void test_sched_handler_41_2(unsigned int dummy)
+{
+	__atomic_store_n(&test_core_flags[1], 1, __ATOMIC_RELEASE);
+}
+
+static void test_sched_handler_41_1(unsigned int dummy)
+{
+	if (so_wait(SO_DEV0) != 0)
+		so_fail("cannot wait");
+	__atomic_store_n(&test_core_flags[0], 1, __ATOMIC_RELEASE);
+}
+
+void test_sched_41(void)
+{
+	so_attr_t attr;
+	int ret;
+
+	memset(&attr, 0, sizeof(attr));
+	memset(test_core_flags, 0, sizeof(test_core_flags));
+	attr.foreign_threads = 1;
+	test_exec_status = SO_TEST_FAIL;
+
+	if (so_init_ex(SO_MAX_UNITS, 1, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_41_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+	/* the task may not wait yet, it is signaled until it is woken */
+	while (!__atomic_load_n(&test_core_flags[0], __ATOMIC_ACQUIRE)) {
+		ret = so_signal(SO_DEV0);
+		if (ret < 0) {
+			so_error("cannot signal");
+			goto test;
+		}
+		if (ret == 0)
+			sched_yield();
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_41_2, 0), INVALID_TID) ||
+	    test_wait_flag(&test_core_flags[1])) {
+		so_error("foreign fork not run");
+		goto test;
+	}
+
+	if (so_wait(SO_DEV0) == 0) {
+		so_error("foreign thread waiting");
+		goto test;
+	}
+
+	test_exec_status = SO_TEST_SUCCESS;
+
+test:
+	so_end();
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 42) Test asynchronous requests
+ *
+ * tests if the signals and forks posted through the inbox reach the tasks,
+ * and if they are refused by a scheduler that is not shared
+ */
+void test_sched_42(void)
+{
+	so_attr_t attr;
+
+	memset(&attr, 0, sizeof(attr));
+	memset(test_core_flags, 0, sizeof(test_core_flags));
+	test_exec_status = SO_TEST_FAIL;
+
+	if (so_init(SO_MAX_UNITS, 1) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (so_signal_async(SO_DEV0) == 0 ||
+	    so_fork_async(test_sched_handler_41_2, 0) == 0) {
+		so_error("requests of a scheduler that is not shared");
+		goto test;
+	}
+	so_end();
+
+	attr.foreign_threads = 1;
+	if (so_init_ex(SO_MAX_UNITS, 1, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (so_signal_async(SO_DEV0 + 1) == 0) {
+		so_error("invalid io device");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_41_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+	/* the task may not wait yet, it is signaled until it is woken */
+	while (!__atomic_load_n(&test_core_flags[0], __ATOMIC_ACQUIRE)) {
+		if (so_signal_async(SO_DEV0) < 0) {
+			so_error("cannot signal");
+			goto test;
+		}
+		sched_yield();
+	}
+
+	if (so_fork_async(test_sched_handler_41_2, 0) < 0 ||
+	    test_wait_flag(&test_core_flags[1])) {
+		so_error("posted fork not run");
+		goto test;
+	}
+
+	test_exec_status = SO_TEST_SUCCESS;
+
+test:
+	so_end();
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 43) Test memory nodes
+ *
+ * tests if the tasks of a faked two nodes topology run at once, each one
+ * pinned to the CPUs of its node when both CPUs may be used, and if a
+ * malformed topology leaves the scheduler free for the next one
+ */
+static cpu_set_t test_node_cpus[2];
+
+static void test_node_pinned(unsigned int flag)
+{
+	if (CPU_COUNT(&test_cpus) == 2 &&
+	    !test_pinned(&test_node_cpus[0]) &&
+	    !test_pinned(&test_node_cpus[1]))
+		so_fail("task not pinned to its node");
+
+	__atomic_store_n(&test_core_flags[flag], 1, __ATOMIC_RELEASE);
+	if (test_wait_flag(&test_core_flags[!flag]))
+		so_fail("tasks not running at once");
+}
+
+static void test_sched_handler_43_2(unsigned int dummy)
+{
+	test_node_pinned(1);
+}
+
+static void test_sched_handler_43_1(unsigned int dummy)
+{
+	if (equal_tids(so_fork(test_sched_handler_43_2, 0), INVALID_TID))
+		so_fail("cannot create new task");
+
+	test_node_pinned(0);
+	test_exec_status = SO_TEST_SUCCESS;
+}
+
+void test_sched_43(void)
+{
+	so_attr_t attr;
+
+	memset(&attr, 0, sizeof(attr));
+	memset(test_core_flags, 0, sizeof(test_core_flags));
+	attr.num_cores = 2;
+	test_exec_status = SO_TEST_FAIL;
+
+	/* the CPUs 0 and 1 as far as the test may run on them */
+	if (sched_getaffinity(0, sizeof(test_cpus), &test_cpus)) {
+		so_error("cannot get the CPUs");
+		goto test;
+	}
+	CPU_ZERO(&test_node_cpus[0]);
+	CPU_SET(0, &test_node_cpus[0]);
+	CPU_ZERO(&test_node_cpus[1]);
+	CPU_SET(1, &test_node_cpus[1]);
+	CPU_AND(&test_node_cpus[0], &test_node_cpus[0], &test_cpus);
+	CPU_AND(&test_node_cpus[1], &test_node_cpus[1], &test_cpus);
+	CPU_OR(&test_cpus, &test_node_cpus[0], &test_node_cpus[1]);
+
+	attr.numa_topology = "0;1;";
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) == 0) {
+		so_error("malformed topology");
+		goto test;
+	}
+
+	attr.numa_topology = "0;1";
+	if (so_init_ex(SO_MAX_UNITS, 0, &attr) < 0) {
+		so_error("initialization failed");
+		goto test;
+	}
+
+	if (equal_tids(so_fork(test_sched_handler_43_1, 0), INVALID_TID)) {
+		so_error("cannot create new task");
+		goto test;
+	}
+
+test:
+	so_end();
+
+	basic_test(test_exec_status);
+}
+
+/*
+ * 44) Test topology descriptions
+ *
+ * tests if the CPU lists of a topology are parsed into nodes and if the
+ * malformed ones are refused
+ */
+void test_sched_44(void)
+{
+	static const char * const malformed[] = {
+		"", ";", "0;", "0;;1", "a", "1-0", "0-", "0,", "0 1", "4096",
+	};
+	Topology topology;
+	unsigned int i;
+	int ret = 0;
+
+	if (parse_topology(&topology, "0-3,8-11;4-7,12") ||
+	    topology.num_nodes != 2 ||
+	    topology.ids[0] != 0 || topology.ids[1] != 1 ||
+	    CPU_COUNT(&topology.cpus[0]) != 8 ||
+	    CPU_COUNT(&topology.cpus[1]) != 5 ||
+	    !CPU_ISSET(11, &topology.cpus[0]) ||
+	    !CPU_ISSET(12, &topology.cpus[1])) {
+		so_error("topology not parsed");
+		ret = -1;
+	}
+
+	for (i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+		if (parse_topology(&topology, malformed[i]) == 0) {
+			so_error("malformed topology \"%s\"", malformed[i]);
+			ret = -1;
+		}
+	}
+
+	basic_test(ret == 0);
+}
@@ -0,0 +1,84 @@
+/*
+ * Threads scheduler coroutine tests
+ *
+ * 2022, Operating Systems
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern "C" {
+#include "scheduler_test.h"
+}
+
+#include "so_coroutine.hpp"
+
+#define SO_DEV0		0
+
+static unsigned int test_exec_step;
+static bool test_exec_failed;
+static tid_t test_main_tid;
+
+/* checks that the steps of the tasks run in order, on the main thread */
+static void test_step(unsigned int expect_step)
+{
+	if (test_exec_step != expect_step || !this_tid(test_main_tid))
+		test_exec_failed = true;
+	test_exec_step++;
+}
+
+/*
+ * 37) Test coroutine tasks
+ *
+ * tests if the awaited scheduling calls resume the tasks by priority, all
+ * on the thread that runs them, if the results can be awaited inside "if"
+ * conditions and if "run" returns once the tasks ended
+ */
+static so::task test_sched_task_37_2(so::scheduler &sched)
+{
+	tid_t self = so_running();
+
+	test_step(1);
+	if (co_await sched.wait(SO_DEV0) != 0)
+		test_exec_failed = true;
+	test_step(3);
+
+	/* the only task of the highest priority goes on at once */
+	co_await sched.exec();
+	if (so_running() != self)
+		test_exec_failed = true;
+	test_step(4);
+}
+
+static so::task test_sched_task_37_1(so::scheduler &sched)
+{
+	so::task child = test_sched_task_37_2(sched);
+
+	test_step(0);
+	if (co_await sched.fork(std::move(child), 1) == INVALID_TID)
+		test_exec_failed = true;
+	test_step(2);
+	if (co_await sched.signal(SO_DEV0) != 1)
+		test_exec_failed = true;
+	test_step(5);
+}
+
+extern "C" void test_sched_37(void)
+{
+	test_exec_step = 0;
+	test_exec_failed = false;
+	test_main_tid = get_tid();
+
+	try {
+		so::scheduler sched(1, 1);
+
+		if (sched.run(test_sched_task_37_1(sched), 0) == INVALID_TID)
+			test_exec_failed = true;
+	} catch (const std::invalid_argument &) {
+		so_error("initialization failed");
+		test_exec_failed = true;
+	}
+
+	basic_test(!test_exec_failed && test_exec_step == 6);
+}
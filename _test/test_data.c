@@ -0,0 +1,367 @@
+/*
+ * Threads scheduler data structure tests
+ *
+ * 2022, Operating Systems
+ */
+
+#include "scheduler_test.h"
+#include "hashtable.h"
+#include "pool.h"
+#include "priority_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SO_TEST_ITEMS		6
+#define SO_TEST_KEYS		100
+#define SO_TEST_POOL_SLOTS	4
+
+/*
+ * 23) Test priority queue
+ *
+ * tests if the bitmap priority queue gives the highest priority first, keeps
+ * the FIFO order within a priority and clears the bit of an emptied level
+ */
+typedef struct test_pq_item_t {
+	ListLink link;
+	unsigned int id;
+} test_pq_item_t;
+
+void test_sched_23(void)
+{
+	static const unsigned int priorities[] = { 1, 3, 1, 0, 3, 5 };
+	static const unsigned int order[] = { 5, 1, 4, 0, 2, 3 };
+	static const unsigned long bitmaps[] = { 0x0b, 0x0b, 0x03,
+						 0x03, 0x01, 0x00 };
+	test_pq_item_t items[SO_TEST_ITEMS];
+	BitmapPQ *pq = initialize_bitmap_pq(SO_MAX_PRIO, NULL);
+	ListLink *link;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < SO_TEST_ITEMS; i++) {
+		items[i].id = i;
+		push_link_bitmap_pq(pq, &items[i].link, priorities[i]);
+	}
+
+	if (pq->size != SO_TEST_ITEMS || pq->bitmap != 0x2b) {
+		so_error("levels not marked");
+		ret = -1;
+	}
+
+	for (i = 0; i < SO_TEST_ITEMS && ret == 0; i++) {
+		link = peak_bitmap_pq(pq);
+		if (link != &items[order[i]].link ||
+		    pop_link_bitmap_pq(pq) != link) {
+			so_error("item %u popped out of order", i);
+			ret = -1;
+		} else if (pq->bitmap != bitmaps[i]) {
+			so_error("level bits %lx after pop %u", pq->bitmap, i);
+			ret = -1;
+		}
+	}
+
+	if (!is_empty_bitmap_pq(pq) || pop_link_bitmap_pq(pq) != NULL ||
+	    peak_bitmap_pq(pq) != NULL) {
+		so_error("queue not empty");
+		ret = -1;
+	}
+
+	free_bitmap_pq(&pq);
+	if (pq != NULL) {
+		so_error("queue not released");
+		ret = -1;
+	}
+
+	basic_test(ret == 0);
+}
+
+/*
+ * 24) Test hash table
+ *
+ * tests if the hash table finds every key while it grows, if a removal
+ * shifts back only the keys that may move before their home slot and if
+ * every entry that leaves is handed to "free_data" exactly once
+ */
+static unsigned int test_freed_entries;
+
+static unsigned int test_hash_identity(void *key)
+{
+	return *(unsigned long *)key;
+}
+
+static int test_compare_keys(void *entry, void *key)
+{
+	return *(unsigned long *)((Entry *)entry)->key != *(unsigned long *)key;
+}
+
+static void test_free_entry(void *data)
+{
+	test_freed_entries++;
+	free_entries(data);
+}
+
+static unsigned long test_slot_key(HashTable *ht, unsigned int index)
+{
+	if (!ht->slots[index].used)
+		return SO_TEST_KEYS;
+
+	return *(unsigned long *)ht->slots[index].entry.key;
+}
+
+void test_sched_24(void)
+{
+	static const unsigned long run[] = { 0, 8, 1, 3 };
+	HashTable *ht;
+	unsigned long key;
+	unsigned int i, value, *found;
+	int ret = 0;
+
+	test_freed_entries = 0;
+	ht = initialize_hashtable(1, hash_function_ulong, test_compare_keys,
+				  NULL, test_free_entry, 1);
+
+	for (key = 0; key < SO_TEST_KEYS; key++) {
+		value = key * 3;
+		put_hashtable(&key, sizeof(key), &value, sizeof(value), ht);
+	}
+
+	if (ht->size != SO_TEST_KEYS ||
+	    ht->size * 4 > ht->capacity * 3 ||
+	    (ht->capacity & (ht->capacity - 1)) != 0) {
+		so_error("table of %u slots for %u keys", ht->capacity,
+			 ht->size);
+		ret = -1;
+	}
+
+	for (key = 0; key < SO_TEST_KEYS; key++) {
+		found = get_value_hashtable(&key, ht);
+		if (found == NULL || *found != key * 3) {
+			so_error("key %lu lost", key);
+			ret = -1;
+		}
+	}
+
+	// A new value replaces the old one without releasing the entry
+	key = 7;
+	value = 1;
+	put_hashtable(&key, sizeof(key), &value, sizeof(value), ht);
+	found = get_value_hashtable(&key, ht);
+	if (found == NULL || *found != 1 || test_freed_entries != 0) {
+		so_error("value not replaced");
+		ret = -1;
+	}
+
+	remove_entry_hashtable(&key, ht);
+	remove_entry_hashtable(&key, ht);
+	if (has_value_hashtable(&key, ht) != 0 || test_freed_entries != 1 ||
+	    ht->size != SO_TEST_KEYS - 1) {
+		so_error("key not removed once");
+		ret = -1;
+	}
+
+	free_hashtable(&ht);
+	if (test_freed_entries != SO_TEST_KEYS) {
+		so_error("%u entries freed", test_freed_entries);
+		ret = -1;
+	}
+
+	/*
+	 * 0 and 8 share slot 0, 1 is pushed out of its slot by 8 and 3 sits in
+	 * its own slot. Removing 0 moves 8 and 1 back, but not 3.
+	 */
+	ht = initialize_hashtable(8, test_hash_identity, test_compare_keys,
+				  NULL, free_entries, 1);
+	for (i = 0; i < 4; i++) {
+		value = run[i];
+		put_hashtable((void *)&run[i], sizeof(run[i]), &value,
+			      sizeof(value), ht);
+	}
+
+	key = 0;
+	remove_entry_hashtable(&key, ht);
+	if (test_slot_key(ht, 0) != 8 || test_slot_key(ht, 1) != 1 ||
+	    test_slot_key(ht, 2) != SO_TEST_KEYS || test_slot_key(ht, 3) != 3) {
+		so_error("probe run not shifted back");
+		ret = -1;
+	}
+
+	for (i = 1; i < 4; i++) {
+		found = get_value_hashtable((void *)&run[i], ht);
+		if (found == NULL || *found != run[i]) {
+			so_error("key %lu lost", run[i]);
+			ret = -1;
+		}
+	}
+
+	free_hashtable(&ht);
+
+	basic_test(ret == 0);
+}
+
+/*
+ * 25) Test empty hash table
+ *
+ * tests if a hash table that was never filled answers lookups and removals
+ * without slots, and allocates them with the first insert
+ */
+void test_sched_25(void)
+{
+	HashTable *ht;
+	unsigned long key = 42;
+	unsigned int value = 7, *found;
+	int ret = 0;
+
+	test_freed_entries = 0;
+	ht = initialize_hashtable(16, hash_function_ulong, test_compare_keys,
+				  NULL, test_free_entry, 1);
+
+	remove_entry_hashtable(&key, ht);
+	if (ht->slots != NULL || ht->size != 0 ||
+	    get_value_hashtable(&key, ht) != NULL ||
+	    has_value_hashtable(&key, ht) != 0) {
+		so_error("empty table not empty");
+		ret = -1;
+	}
+
+	free_hashtable(&ht);
+	if (test_freed_entries != 0) {
+		so_error("entries freed from an empty table");
+		ret = -1;
+	}
+
+	ht = initialize_hashtable(16, hash_function_ulong, test_compare_keys,
+				  NULL, test_free_entry, 1);
+	put_hashtable(&key, sizeof(key), &value, sizeof(value), ht);
+
+	found = get_value_hashtable(&key, ht);
+	if (ht->slots == NULL || ht->capacity != 16 || ht->size != 1 ||
+	    found == NULL || *found != 7) {
+		so_error("first insert lost");
+		ret = -1;
+	}
+
+	free_hashtable(&ht);
+	if (test_freed_entries != 1) {
+		so_error("%u entries freed", test_freed_entries);
+		ret = -1;
+	}
+
+	basic_test(ret == 0);
+}
+
+/*
+ * 26) Test node pool
+ *
+ * tests if the pool hands a released slot out again before growing, and adds
+ * a chunk once every slot is taken
+ */
+void test_sched_26(void)
+{
+	MemoryPool *pool = initialize_pool(1, SO_TEST_POOL_SLOTS, NULL);
+	char *slots[SO_TEST_POOL_SLOTS + 1];
+	void *first_chunk;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < SO_TEST_POOL_SLOTS; i++) {
+		slots[i] = alloc_pool(pool);
+		if (slots[i] == NULL ||
+		    (unsigned long)slots[i] % POOL_ALIGNMENT != 0) {
+			so_error("bad slot %u", i);
+			ret = -1;
+		}
+		memset(slots[i], i, pool->slot_size);
+	}
+
+	first_chunk = pool->chunks;
+	if (first_chunk == NULL || pool->free_slots != NULL) {
+		so_error("chunk not filled");
+		ret = -1;
+	}
+
+	release_pool(pool, slots[1]);
+	if (alloc_pool(pool) != slots[1] || pool->chunks != first_chunk) {
+		so_error("released slot not reused");
+		ret = -1;
+	}
+
+	slots[SO_TEST_POOL_SLOTS] = alloc_pool(pool);
+	if (pool->chunks == first_chunk ||
+	    *(void **)pool->chunks != first_chunk) {
+		so_error("pool not grown");
+		ret = -1;
+	}
+
+	// The slots of the first chunk kept their content
+	for (i = 0; i < SO_TEST_POOL_SLOTS; i++)
+		if (i != 1 && slots[i][pool->slot_size - 1] != (char)i) {
+			so_error("slot %u overwritten", i);
+			ret = -1;
+		}
+
+	free_pool(&pool);
+	if (pool != NULL) {
+		so_error("pool not released");
+		ret = -1;
+	}
+
+	basic_test(ret == 0);
+}
+
+/*
+ * 27) Test typed hash table
+ *
+ * tests if a generated hash table stores its values inline, finds every key
+ * while it grows and keeps the other keys reachable after removals
+ */
+DECLARE_TYPED_HASHTABLE(test_map, unsigned long, unsigned int,
+			hash_ulong_typed, EQUAL_SCALAR_TYPED)
+
+void test_sched_27(void)
+{
+	test_map map;
+	unsigned long key;
+	unsigned int *found;
+	int ret = 0;
+
+	initialize_test_map(&map, 0, NULL);
+	if (get_test_map(1, &map) != NULL || map.slots != NULL) {
+		so_error("empty map not empty");
+		ret = -1;
+	}
+
+	for (key = 0; key < SO_TEST_KEYS; key++)
+		put_test_map(key, key * 3, &map);
+
+	found = get_test_map(7, &map);
+	if (found != NULL)
+		*found = 1;
+
+	// Every even key leaves, the odd ones must still be found
+	for (key = 0; key < SO_TEST_KEYS; key += 2)
+		remove_test_map(key, &map);
+
+	if (map.size != SO_TEST_KEYS / 2 || map.size * 4 > map.capacity * 3) {
+		so_error("map of %u slots for %u keys", map.capacity,
+			 map.size);
+		ret = -1;
+	}
+
+	for (key = 0; key < SO_TEST_KEYS; key++) {
+		found = get_test_map(key, &map);
+		if (key % 2 == 0 ? found != NULL :
+		    found == NULL || *found != (key == 7 ? 1 : key * 3)) {
+			so_error("key %lu wrong", key);
+			ret = -1;
+		}
+	}
+
+	free_test_map(&map);
+	if (map.slots != NULL || map.size != 0) {
+		so_error("map not released");
+		ret = -1;
+	}
+
+	basic_test(ret == 0);
+}
@@ -0,0 +1,116 @@
+#define _GNU_SOURCE
+#include "topology.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TOPOLOGY_LINE_SIZE 4096
+
+/**
+ * @brief Parses a CPU list like the kernel prints it ("0-3,8,10-11"), it
+ * stops at the first character that does not continue the list.
+ *
+ * @param text where the list starts, moved past its end
+ * @param cpus where the CPU set is stored
+ * @return int "0" on success, "-1" on a malformed list
+ */
+static int parse_cpu_list(const char **text, cpu_set_t *cpus)
+{
+	unsigned long first, last;
+	char *end;
+
+	CPU_ZERO(cpus);
+	for (;;) {
+		first = strtoul(*text, &end, 10);
+		if (end == *text)
+			return -1;
+
+		last = first;
+		if (*end == '-') {
+			*text = end + 1;
+			last = strtoul(*text, &end, 10);
+			if (end == *text || last < first)
+				return -1;
+		}
+
+		if (last >= CPU_SETSIZE)
+			return -1;
+
+		for (; first <= last; ++first)
+			CPU_SET(first, cpus);
+
+		*text = end;
+		if (**text != ',')
+			return 0;
+		(*text)++;
+	}
+}
+
+/**
+ * @brief Parses a topology description, one CPU list per memory node
+ * separated by ';' ("0-3,8-11;4-7,12-15" for two nodes), the i-th list is
+ * memory node i. The CPUs do not have to exist, so any topology can be faked
+ * on a single-node machine.
+ *
+ * @param topology where the nodes are stored
+ * @param description text of the topology
+ * @return int "0" on success, "-1" on a malformed description
+ */
+int parse_topology(Topology *topology, const char *description)
+{
+	const char *text = description;
+
+	topology->num_nodes = 0;
+	for (;;) {
+		if (topology->num_nodes == TOPOLOGY_MAX_NODES ||
+		    parse_cpu_list(&text,
+				   &topology->cpus[topology->num_nodes]))
+			return -1;
+
+		topology->ids[topology->num_nodes] = topology->num_nodes;
+		topology->num_nodes++;
+		if (*text == '\0')
+			return 0;
+		if (*text++ != ';')
+			return -1;
+	}
+}
+
+/**
+ * @brief Reads the memory nodes of the machine, their numbers and their CPUs,
+ * nodes without CPUs are skipped. Without NUMA support every CPU is on a
+ * single node.
+ *
+ * @param topology where the nodes are stored
+ */
+void read_topology(Topology *topology)
+{
+	char path[64], line[TOPOLOGY_LINE_SIZE];
+	const char *text;
+	unsigned int node, cpu;
+	FILE *file;
+
+	topology->num_nodes = 0;
+	for (node = 0; node < TOPOLOGY_MAX_NODES; ++node) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%u/cpulist", node);
+		file = fopen(path, "r");
+		if (file == NULL)
+			continue;
+
+		text = line;
+		if (fgets(line, sizeof(line), file) &&
+		    !parse_cpu_list(&text,
+				    &topology->cpus[topology->num_nodes]))
+			topology->ids[topology->num_nodes++] = node;
+
+		fclose(file);
+	}
+
+	if (topology->num_nodes == 0) {
+		CPU_ZERO(&topology->cpus[0]);
+		for (cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			CPU_SET(cpu, &topology->cpus[0]);
+		topology->ids[0] = 0;
+		topology->num_nodes = 1;
+	}
+}
@@ -0,0 +1,18 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <sched.h>
+
+#define TOPOLOGY_MAX_NODES 64
+
+typedef struct Topology {
+	cpu_set_t cpus[TOPOLOGY_MAX_NODES];
+	unsigned int ids[TOPOLOGY_MAX_NODES];
+	unsigned int num_nodes;
+} Topology;
+
+int parse_topology(Topology *topology, const char *description);
+
+void read_topology(Topology *topology);
+
+#endif
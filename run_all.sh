@@ -135,7 +135,7 @@ init_test()
 
 PASS=0
 FAIL=1
-TESTS_SKIP_MEMCHECK=(15 16 17 21) # skip round robin and stress tests
+TESTS_SKIP_MEMCHECK=(15 16 17 21 27) # skip round robin, stress and green tests
 
 test_sched()
 {
@@ -205,6 +205,28 @@ test_fun_array=(                                                      \
         test_sched      "Test IO schedule"                      7   1 \
         test_sched      "Test priorities and IO"                10  1 \
         test_sched      "Test priorities and IO (stress test)"  12  0 \
+        test_sched      "Test priority queue"                   0   0 \
+        test_sched      "Test hash table"                       0   0 \
+        test_sched      "Test empty hash table"                 0   0 \
+        test_sched      "Test node pool"                        0   0 \
+        test_sched      "Test typed hash table"                 0   0 \
+        test_sched      "Test green tasks"                      0   0 \
+        test_sched      "Test extended init params"             0   0 \
+        test_sched      "Test adaptive wait"                    0   0 \
+        test_sched      "Test scheduler stats"                  0   0 \
+        test_sched      "Test thread pool"                      0   0 \
+        test_sched      "Test task stack size"                  0   0 \
+        test_sched      "Test CPU mask"                         0   0 \
+        test_sched      "Test failed extended init"             0   0 \
+        test_sched      "Test external tasks"                   0   0 \
+        test_sched      "Test coroutine tasks"                  0   0 \
+        test_sched      "Test end of tasks"                     0   0 \
+        test_sched      "Test several cores"                    0   0 \
+        test_sched      "Test stealing"                         0   0 \
+        test_sched      "Test foreign threads"                  0   0 \
+        test_sched      "Test asynchronous requests"            0   0 \
+        test_sched      "Test memory nodes"                     0   0 \
+        test_sched      "Test topology descriptions"            0   0 \
 )
 
 last_test=$((${#test_fun_array[@]} / 4))